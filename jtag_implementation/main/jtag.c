@@ -0,0 +1,777 @@
+#include <stdio.h>
+#include "jtag_io.h"
+#include "jtag.h"
+#include "jtag_engine.h"
+#include "jtag_queue.h"
+#include "jtag_sync.h"
+#include "jtag_trace.h"
+
+const uint8_t IR_ADDR_16BIT = 0x83;
+const uint8_t IR_ADDR_CAPTURE = 0x84;
+const uint8_t IR_DATA_TO_ADDR = 0x85;
+const uint8_t IR_DATA_16BIT = 0x41;
+const uint8_t IR_DATA_CAPTURE = 0x42;
+const uint8_t IR_DATA_QUICK = 0x43;
+const uint8_t IR_BYPASS = 0xFF;
+const uint8_t IR_CNTRL_SIG_16BIT = 0x13;
+const uint8_t IR_CNTRL_SIG_CAPTURE = 0x14;
+const uint8_t IR_CNTRL_SIG_RELEASE = 0x15;
+const uint8_t IR_DATA_PSA = 0x44;
+const uint8_t IR_SHIFT_OUT_PSA = 0x46;
+const uint8_t IR_Prepare_Blow = 0x22;
+const uint8_t IR_Ex_Blow = 0x24;
+const uint8_t IR_JMB_EXCHANGE = 0x61;
+
+static const jtag_engine_t *engine = &gpio_fast_engine;
+
+void SetShiftEngine(const jtag_engine_t *next) {
+    engine = next;
+}
+
+const jtag_engine_t *GetShiftEngine(void) {
+    return engine;
+}
+
+uint32_t ReverseBits(uint32_t data, int count) {
+    uint32_t ret = 0;
+    for (int i = 0; i < count; i++) {
+        ret = (ret << 1) | ((data >> i) & 0x01);
+    }
+    return ret;
+}
+
+/*
+    Shifts bits of data into the instruction register
+    (SCAN_IR) or the addressed data register (SCAN_DR)
+    via the TDI, starting and ending in Run/Idle. At the
+    same time, the register contents are shifted out via
+    the TDO. order applies to both directions: with
+    MSB_FIRST the first bit out of TDO lands in bit
+    (bits - 1) of the result, with LSB_FIRST in bit 0.
+    Up to 32 bits per scan.
+
+    Returns: Value shifted out of the register.
+*/
+uint32_t SCAN(scan_reg_t reg, uint32_t data, int bits, bit_order_t order) {
+    uint32_t ret;
+    QueueScan(reg, data, bits, order, &ret, sizeof(ret));
+    QueueFlush();
+    return ret;
+}
+
+/*
+    Shifts an 8-bit JTAG instruction into the JTAG
+    instruction register via the TDI. At the same time,
+    the 8-bit JTAG ID is shifted out via the TDO. Each
+    instruction bit is captured from TDI on the rising
+    edge of the TCK. Shifted LSB first.
+
+    Returns: 8-bit JTAG ID
+*/
+uint8_t IR_SHIFT(uint8_t input_data) {
+    // the instruction goes in LSB first, but the JTAG ID
+    // reads MSB first, so reverse the input only
+    uint32_t start = TraceNow();
+    uint8_t id = SCAN(SCAN_IR, ReverseBits(input_data, 8), 8, MSB_FIRST);
+    TraceLatency(TRACE_IR_SHIFT, start);
+    return id;
+}
+
+/*
+    Shifts a 16-bit word into the JTAG data register (DR).
+    The word is shifted, MSB first, via the TDI. At the
+    same time, the last captured and stored value in the
+    addressed data register is shifted out via the TDO. A
+    new bit is present at TDO with a falling edge of TCK.
+    Shifted MSB first.
+
+    Returns: Last captured and stored value in the
+    addressed data register.
+*/
+uint16_t DR_SHIFT(uint16_t input_data) {
+    uint32_t start = TraceNow();
+    uint16_t ret = SCAN(SCAN_DR, input_data, 16, MSB_FIRST);
+    TraceLatency(TRACE_DR_SHIFT, start);
+    return ret;
+}
+
+/*
+    Shifts a 20-bit address into the JTAG data register
+    of an MSP430X device, MSB first. The device shifts the
+    captured address out as bits 15-0 followed by bits
+    19-16, which is put back in order here.
+
+    Returns: Last captured 20-bit address.
+*/
+uint32_t DR_SHIFT20(uint32_t input_data) {
+    uint32_t ret = SCAN(SCAN_DR, input_data & 0xFFFFF, 20, MSB_FIRST);
+    return ((ret << 16) | (ret >> 4)) & 0xFFFFF;
+}
+
+/*
+    Sets TCLK to LOW, which acts as the falling edge of
+    the CPU clock. Executed in the Run/Idle state. Note
+    that the MSP430 is not pipelined, so a full TCLK cycle
+    executes the CPU instruction located at the PC.
+*/
+void ClrTCLK() {
+    QueueClrTCLK();
+    QueueFlush();
+}
+
+/*
+    Sets TCLK to HIGH, which acts as the rising edge of
+    the CPU clock. Executed in the Run/Idle state. Note
+    that the MSP430 is not pipelined, so a full TCLK cycle
+    executes the CPU instruction located at the PC.
+*/
+void SetTCLK() {
+    QueueSetTCLK();
+    QueueFlush();
+}
+
+/*
+    Resets the TAP to Test-Logic-Reset, moves it to Run/
+    Idle with TCLK high, and performs the fuse check: TMS
+    pulses while TCK stays put, which is done on the pins
+    as it is no TAP transition. Over Spy-Bi-Wire the
+    pulses are clocked TMS cycles instead.
+*/
+void ResetTAP() {
+    QueueResetTap();
+    QueueSetTCLK();
+    QueueFlush();
+
+    if (GetShiftEngine() == &sbw_engine) {
+        // TMS only moves with a clock here, so the pulses take a
+        // detour through the DR states back to Run/Idle
+        QueueTms(0x35, 7);
+        QueueFlush();
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        PinSet(TMS, HIGH);
+        PinSet(TMS, LOW);
+    }
+}
+
+static void DelayMs(int ms) {
+    for (int i = 0; i < ms; i++) {
+        DelayNs(1000000);
+    }
+}
+
+/*
+    Spy-Bi-Wire entry sequence with RST high (SLAU320,
+    Fig. 2-14): TEST high enables the TEST logic, then a
+    short TEST pulse while RST stays high selects SBW over
+    4-wire JTAG. Select sbw_engine afterwards.
+*/
+void EnterSBW() {
+    PinSet(SBWTCK, LOW);
+    DelayMs(4); // reset the TEST logic
+    PinSet(SBWTDIO, HIGH);
+    PinSet(SBWTCK, HIGH);
+    DelayMs(20); // activate the TEST logic
+    DelayNs(40000);
+    PinSet(SBWTCK, LOW);
+    DelayNs(1000);
+    PinSet(SBWTCK, HIGH);
+    DelayNs(40000);
+    DelayMs(5);
+}
+
+/*
+    4-wire JTAG entry sequence with RST held low, case 2a
+    of SLAU320 Fig. 2-13. Follow it with ResetTAP.
+*/
+void EnterJTAG() {
+    PinSet(RST, HIGH);
+    PinSet(TEN, LOW);
+        // there is a ~28 microsecond delay
+    PinSet(TEN, HIGH);
+    PinSet(RST, LOW);
+    PinSet(TEN, LOW);
+    PinSet(TEN, HIGH);
+    PinSet(RST, HIGH);
+}
+
+/*
+    Takes the CPU under JTAG Control. The sync is polled
+    for at most SYNC_TIMEOUT_MS, see jtag_sync.h.
+
+    Returns: false if the CPU did not sync.
+*/
+bool GetDevice() {
+    printf("Syncing CPU...\n");
+    uint32_t start = TraceNow();
+    IR_SHIFT(IR_CNTRL_SIG_16BIT);
+    DR_SHIFT((uint16_t) 0x2401);
+    IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
+    bool synced = SyncPoll(0x0200);
+    // the poll is most of the time, synced or not
+    TraceLatency(TRACE_GET_DEVICE, start);
+    if (synced) {
+        printf("Sync Successful!\n");
+        return true;
+    }
+    printf("Sync timed out!\n");
+    return false;
+}
+
+/*
+    Releases CPU from JTAG control. The target CPU
+    starts program execution with the address stored
+    at location 0x0FFFE (reset vector).
+    
+    This function is very distinct from ReleaseCPU!
+*/
+void ReleaseDevice() {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2C01, NULL); // apply reset
+    QueueDR((uint16_t) 0x2401, NULL); // remove reset
+    QueueIR(IR_CNTRL_SIG_RELEASE);
+    QueueFlush();
+}
+
+/*
+    Loads the PC with addr and lets the CPU run from there
+    on its own clock, out of JTAG control. GetDevice takes
+    control back.
+*/
+void ReleaseDeviceAt(uint16_t addr) {
+    SetPC(addr);
+    QueueIR(IR_CNTRL_SIG_RELEASE);
+    QueueFlush();
+}
+
+/*
+    Sets the CPU to instruction-fetch state. This is used
+    to execute an instruction presented by a host over the
+    JTAG port.
+
+    Returns: false if the CPU did not get there.
+*/
+bool SetInstrFetch() {
+    uint32_t start = TraceNow();
+    IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
+    for (int i = 0; i < 8; i++) {
+        if (DR_SHIFT((uint16_t) 0x0000) & 0x0080) {
+            TraceLatency(TRACE_SET_INSTR_FETCH, start);
+            return true;
+        }
+        ClrTCLK();
+        SetTCLK();
+    }
+    printf("SetInstrFetch Unsuccessful!\n");
+    return false;
+}
+
+/*
+    Loads the target device CPU's program counter 
+    with the desired 16-bit address.
+*/
+void SetPC(uint16_t addr) {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    QueueIR(IR_DATA_16BIT);
+    QueueDR((uint16_t) 0x4030, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueDR(addr, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueIR(IR_ADDR_CAPTURE);
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+}
+
+/*
+    Loads the program counter of an MSP430X device with
+    a 20-bit address, by injecting MOVA #imm20, PC.
+*/
+void SetPC_430X(uint32_t addr) {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    QueueIR(IR_DATA_16BIT);
+    QueueDR((uint16_t) (0x0080 | ((addr >> 8) & 0x0F00)), NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueDR((uint16_t) addr, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueIR(IR_ADDR_CAPTURE);
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+}
+
+/*
+    Force a power-up reset of CPU
+*/
+void ExecutePOR() {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2c01, NULL);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueIR(IR_ADDR_CAPTURE);
+    QueueSetTCLK();
+    QueueFlush();
+}
+
+/*
+    Stopping of the CPU via the HALT_JTAG bit of the JTAG
+    control signal register, which is set to 1 here.
+*/
+void HaltCPU() {
+    uint32_t start = TraceNow();
+    // Execute JMP $ instr to maintain state
+    QueueIR(IR_DATA_16BIT);
+    QueueDR((uint16_t) 0x3FFF, NULL);
+    QueueClrTCLK();
+    // set halt bit in cntrl signal
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2409, NULL);
+    QueueSetTCLK();
+    QueueFlush();
+    TraceLatency(TRACE_HALT_CPU, start);
+}
+
+/*
+    Starting of the CPU via the HALT_JTAG bit of the JTAG
+    control signal register, which is set to 0 here.
+*/
+void ReleaseCPU() {
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueIR(IR_ADDR_CAPTURE);
+    QueueSetTCLK();
+    QueueFlush();
+}
+
+#define PC_READ_OFFSET 2 // bytes a read of R0 falls short of the halted PC, see QueueCpuRead
+
+// JMP $-4, two cycles, makes up for the 4 bytes an injected MOV moves the PC on
+static void QueueJmpBack(void) {
+    QueueIR(IR_DATA_16BIT);
+    QueueDR((uint16_t) 0x3FFD, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueSetTCLK();
+}
+
+/*
+    Queues MOV Rn, &CPU_SCRATCH, capturing Rn from the data
+    bus during its write cycle, for a CPU that controls RW
+    and BYTE. The MOV does store Rn there, see SaveScratch.
+    The JMP before it leaves the MOV 4 bytes below the
+    halted PC, and a PC source reads as the address after
+    the opcode, so R0 comes back PC_READ_OFFSET short.
+*/
+static void QueueCpuRead(int reg, uint16_t *dest) {
+    QueueJmpBack();
+    QueueDR((uint16_t) (0x4082 | ((reg << 8) & 0x0F00)), NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueDR((uint16_t) CPU_SCRATCH, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueIR(IR_DATA_CAPTURE);
+    QueueDR((uint16_t) 0x0000, dest);
+    QueueSetTCLK();
+}
+
+// Queues MOV #value, Rn, likewise
+static void QueueCpuWrite(int reg, uint16_t value) {
+    QueueJmpBack();
+    QueueDR((uint16_t) (0x4030 | (reg & 0x0F)), NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+    QueueDR(value, NULL);
+    QueueClrTCLK();
+    QueueSetTCLK();
+}
+
+/*
+    Reads the word the register reads are about to
+    overwrite. It has to arrive before its write-back can
+    be queued, so this flushes.
+*/
+static uint16_t SaveScratch(void) {
+    uint16_t saved;
+    QueueReadMem(CPU_SCRATCH, &saved);
+    QueueSetTCLK();
+    QueueFlush();
+    return saved;
+}
+
+/*
+    Reads CPU register reg by injecting MOV Rn,
+    &CPU_SCRATCH and capturing the data bus during its
+    write cycle. The word at CPU_SCRATCH is read before
+    and written back after. The CPU must be halted in
+    instruction fetch state.
+*/
+uint16_t ReadCpuReg(int reg) {
+    uint16_t value;
+    uint16_t scratch = SaveScratch();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL); // CPU controls RW and BYTE
+    QueueCpuRead(reg, &value);
+    QueueWriteMem(CPU_SCRATCH, scratch);
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+    return reg == 0 ? value + PC_READ_OFFSET : value;
+}
+
+/*
+    Loads CPU register reg by injecting MOV #value, Rn.
+*/
+void WriteCpuReg(int reg, uint16_t value) {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    QueueCpuWrite(reg, value);
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+}
+
+/*
+    Saves R0-R15 into regs with one injected sequence: the
+    CPU gets RW and BYTE once and the queue is flushed
+    once after saving CPU_SCRATCH, instead of once per
+    register. R3, the constant generator, reads as 0.
+*/
+void ReadCpuRegs(uint16_t *regs) {
+    uint16_t scratch = SaveScratch();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    for (int reg = 0; reg < CPU_REGS; reg++) {
+        if (reg == 3) {
+            regs[reg] = 0;
+        } else {
+            QueueCpuRead(reg, &regs[reg]);
+        }
+    }
+    QueueWriteMem(CPU_SCRATCH, scratch);
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+    regs[0] += PC_READ_OFFSET;
+}
+
+/*
+    Loads the registers whose bit is set in mask from regs,
+    batched like ReadCpuRegs. SR goes after the others, so
+    its CPUOFF and GIE bits cannot affect them, and PC
+    last, since the JMP before each injection moves it.
+*/
+void WriteCpuRegs(const uint16_t *regs, uint16_t mask) {
+    static const uint8_t order[] = {1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 2, 0};
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    for (size_t i = 0; i < sizeof(order); i++) {
+        if (mask & (1 << order[i])) QueueCpuWrite(order[i], regs[order[i]]);
+    }
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+}
+
+/*
+    Executes one instruction from the current PC: the CPU
+    gets RW and BYTE and is clocked until the next
+    instruction fetch, for at most STEP_CLOCKS TCLK cycles.
+    The CPU is halted again afterwards.
+
+    Returns: false if no instruction fetch was seen.
+*/
+bool StepCPU() {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x3401, NULL);
+    QueueIR(IR_CNTRL_SIG_CAPTURE);
+    uint16_t status = 0;
+    for (int i = 0; i < STEP_CLOCKS && !(status & 0x0080); i++) {
+        QueueClrTCLK();
+        QueueSetTCLK();
+        QueueDR((uint16_t) 0x0000, &status);
+        QueueFlush();
+    }
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2401, NULL);
+    QueueFlush();
+    HaltCPU();
+    return status & 0x0080;
+}
+
+/*
+    Queues a read of one word (2 bytes) of memory at addr.
+    The word lands in *dest on the next QueueFlush.
+*/
+void QueueReadMem(uint16_t addr, uint16_t *dest) {
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2409, NULL); // one word, not byte
+    QueueIR(IR_ADDR_16BIT);
+    QueueDR(addr, NULL);
+    QueueIR(IR_DATA_TO_ADDR);
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueDR((uint16_t) 0x0000, dest);
+}
+
+/*
+    Reads one word (2 bytes) of memory at addr.
+*/
+uint16_t ReadMem(uint16_t addr) {
+    uint32_t start = TraceNow();
+    uint16_t data;
+    QueueReadMem(addr, &data);
+    QueueFlush();
+    TraceLatency(TRACE_READ_MEM, start);
+    return data;
+}
+
+/*
+    Queues a write of one word (2 bytes) of memory at addr.
+*/
+void QueueWriteMem(uint16_t addr, uint16_t data) {
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2408, NULL);
+    QueueIR(IR_ADDR_16BIT);
+    QueueDR(addr, NULL);
+    QueueIR(IR_DATA_TO_ADDR);
+    QueueDR(data, NULL);
+    QueueSetTCLK();
+}
+
+void WriteMem(uint16_t addr, uint16_t data) {
+    uint32_t start = TraceNow();
+    QueueWriteMem(addr, data);
+    QueueFlush();
+    TraceLatency(TRACE_WRITE_MEM, start);
+}
+
+/*
+    Reads one word (2 bytes) of memory at a 20-bit addr
+    on an MSP430X device.
+*/
+uint16_t ReadMem_430X(uint32_t addr) {
+    uint16_t data;
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2409, NULL); // one word, not byte
+    QueueIR(IR_ADDR_16BIT);
+    QueueScan(SCAN_DR, addr & 0xFFFFF, 20, MSB_FIRST, NULL, 0);
+    QueueIR(IR_DATA_TO_ADDR);
+    QueueSetTCLK();
+    QueueClrTCLK();
+    QueueDR((uint16_t) 0x0000, &data);
+    QueueFlush();
+    return data;
+}
+
+void WriteMem_430X(uint32_t addr, uint16_t data) {
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2408, NULL);
+    QueueIR(IR_ADDR_16BIT);
+    QueueScan(SCAN_DR, addr & 0xFFFFF, 20, MSB_FIRST, NULL, 0);
+    QueueIR(IR_DATA_TO_ADDR);
+    QueueDR(data, NULL);
+    QueueSetTCLK();
+    QueueFlush();
+}
+
+/*
+    Quick memory access: with IR_DATA_QUICK selected the
+    PC is the address pointer and moves on by one word on
+    every TCLK, so each word costs one DR scan instead of
+    the five scans of ReadMem/WriteMem. The first access
+    lands two words past the loaded PC, which is why the
+    block routines load it with addr - 4.
+*/
+static void QuickRead(uint16_t length, uint16_t *data) {
+    HaltCPU();
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2409, NULL); // set RW to read
+    QueueIR(IR_DATA_QUICK);
+    for (uint16_t i = 0; i < length; i++) {
+        QueueSetTCLK();
+        QueueClrTCLK();
+        QueueDR((uint16_t) 0x0000, &data[i]);
+    }
+    QueueFlush();
+    ReleaseCPU();
+}
+
+static void QuickWrite(uint16_t length, const uint16_t *data) {
+    HaltCPU();
+    QueueClrTCLK();
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2408, NULL); // set RW to write
+    QueueIR(IR_DATA_QUICK);
+    for (uint16_t i = 0; i < length; i++) {
+        QueueDR(data[i], NULL);
+        QueueSetTCLK();
+        QueueClrTCLK(); // PC += 2
+    }
+    // TCLK stays low: another rise would store the last word again
+    QueueFlush();
+    ReleaseCPU();
+}
+
+/*
+    Reads length consecutive words starting at addr into
+    data. Like SetPC, this expects the CPU in instruction-
+    fetch state; the CPU is released afterwards.
+*/
+void ReadMemQuick(uint16_t addr, uint16_t length, uint16_t *data) {
+    SetPC(addr - 4);
+    QuickRead(length, data);
+}
+
+void WriteMemQuick(uint16_t addr, uint16_t length, const uint16_t *data) {
+    SetPC(addr - 4);
+    QuickWrite(length, data);
+}
+
+void ReadMemQuick_430X(uint32_t addr, uint16_t length, uint16_t *data) {
+    SetPC_430X(addr - 4);
+    QuickRead(length, data);
+}
+
+void WriteMemQuick_430X(uint32_t addr, uint16_t length, const uint16_t *data) {
+    SetPC_430X(addr - 4);
+    QuickWrite(length, data);
+}
+
+/*
+    One step of the PSA signature register, the same
+    polynomial (0x0805) the target applies to every word.
+*/
+static uint16_t PsaStep(uint16_t psa, uint16_t data) {
+    if (psa & 0x8000) {
+        psa ^= 0x0805;
+        psa <<= 1;
+        psa |= 0x0001;
+    } else {
+        psa <<= 1;
+    }
+    return psa ^ data;
+}
+
+/*
+    Signature the target's PSA ends with after length words
+    from addr, holding image or erased if image is NULL, as
+    the SLAU320 VerifyPSA computes it.
+*/
+uint16_t PsaSignature(uint16_t addr, uint16_t length, const uint16_t *image) {
+    uint16_t psa = addr - 2;
+    for (uint16_t i = 0; i < length; i++) {
+        psa = PsaStep(psa, image != NULL ? image[i] : 0xFFFF);
+    }
+    return psa;
+}
+
+/*
+    Runs the PSA over length words from the current PC and
+    compares the signature shifted out with one computed
+    from image, or from erased words if image is NULL.
+*/
+static bool PsaCheck(uint16_t start, uint16_t length, const uint16_t *image) {
+    uint16_t signature;
+    QueueSetTCLK();
+    QueueIR(IR_DATA_PSA);
+    for (uint16_t i = 0; i < length; i++) {
+        QueueClrTCLK();
+        QueueTms(0x19, 6); // Select DR, Capture DR, Shift DR, Exit1, Update, IDLE
+        QueueSetTCLK();
+    }
+    QueueIR(IR_SHIFT_OUT_PSA);
+    QueueDR((uint16_t) 0x0000, &signature);
+    QueueSetTCLK();
+    QueueFlush();
+    return signature == PsaSignature(start, length, image);
+}
+
+/*
+    Verifies length words from addr against image with the
+    target's pseudo-signature analysis: one signature scan
+    for the whole range instead of one read per word. The
+    CPU is reset first, as SLAU320 prescribes.
+
+    Returns: true if the target matches the image.
+*/
+bool VerifyPSA(uint16_t addr, uint16_t length, const uint16_t *image) {
+    ExecutePOR();
+    SetPC(addr);
+    return PsaCheck(addr, length, image);
+}
+
+bool VerifyPSA_430X(uint32_t addr, uint16_t length, const uint16_t *image) {
+    ExecutePOR();
+    SetPC_430X(addr);
+    return PsaCheck(addr, length, image);
+}
+
+/*
+    Checks that length words from addr are erased
+    (0xFFFF), so erasing them again can be skipped.
+*/
+bool EraseCheck(uint16_t addr, uint16_t length) {
+    return VerifyPSA(addr, length, NULL);
+}
+
+bool EraseCheck_430X(uint32_t addr, uint16_t length) {
+    return VerifyPSA_430X(addr, length, NULL);
+}
+
+bool CheckLink(void) {
+    static const uint16_t patterns[] = {0x0000, 0xFFFF, 0xAAAA, 0x5555, 0x4411, 0xDEAD, 0x8001, 0x7FFE};
+    bool ok = true;
+    for (int i = 0; ok && i < (int) (sizeof(patterns) / sizeof(patterns[0])); i++) {
+        // the one-bit bypass register captures 0 and delays the pattern by a bit
+        ok = IR_SHIFT(IR_BYPASS) == JTAG_ID && DR_SHIFT(patterns[i]) == patterns[i] >> 1;
+    }
+    return ok;
+}
+
+static bool CheckRate(uint32_t hz) {
+    SetTckRate(hz);
+    for (int i = 0; i < TCK_CHECK_PASSES; i++) {
+        if (!CheckLink()) return false;
+    }
+    return true;
+}
+
+uint32_t CalibrateTck(void) {
+    static const uint32_t rates[] = {100000, 200000, 500000, 1000000, 2000000,
+                                     4000000, 5000000, 8000000, 10000000};
+    int count = sizeof(rates) / sizeof(rates[0]);
+    int passed = -1;
+    while (passed + 1 < count && CheckRate(rates[passed + 1])) passed++;
+
+    if (passed < 0) {
+        SetTckRate(rates[0]);
+        return 0;
+    }
+    int chosen = passed > 0 && passed < count - 1 ? passed - 1 : passed;
+    SetTckRate(rates[chosen]);
+    return rates[chosen];
+}
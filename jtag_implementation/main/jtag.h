@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern const uint8_t IR_ADDR_16BIT;
+extern const uint8_t IR_ADDR_CAPTURE;
+extern const uint8_t IR_DATA_TO_ADDR;
+extern const uint8_t IR_DATA_16BIT;
+extern const uint8_t IR_DATA_CAPTURE;
+extern const uint8_t IR_DATA_QUICK;
+extern const uint8_t IR_BYPASS;
+extern const uint8_t IR_CNTRL_SIG_16BIT;
+extern const uint8_t IR_CNTRL_SIG_CAPTURE;
+extern const uint8_t IR_CNTRL_SIG_RELEASE;
+extern const uint8_t IR_DATA_PSA;
+extern const uint8_t IR_SHIFT_OUT_PSA;
+extern const uint8_t IR_Prepare_Blow;
+extern const uint8_t IR_Ex_Blow;
+extern const uint8_t IR_JMB_EXCHANGE;
+
+#define JTAG_ID 0x89 // shifted out of the IR by every MSP430 F1xx-F4xx
+
+#define TCK_CHECK_PASSES 8 // CheckLink runs per rate during calibration
+#define STEP_CLOCKS 10     // TCLK cycles StepCPU allows, more than the longest instruction
+#define CPU_REGS 16        // R0-R15, as ReadCpuRegs and WriteCpuRegs pass them
+#define CPU_SCRATCH 0x0200 // RAM word register reads pass through, put back after
+
+typedef enum {
+    SCAN_IR,
+    SCAN_DR,
+} scan_reg_t;
+
+typedef enum {
+    MSB_FIRST,
+    LSB_FIRST,
+} bit_order_t;
+
+uint32_t ReverseBits(uint32_t data, int count);
+uint32_t SCAN(scan_reg_t reg, uint32_t data, int bits, bit_order_t order);
+uint8_t IR_SHIFT(uint8_t input_data);
+uint16_t DR_SHIFT(uint16_t input_data);
+uint32_t DR_SHIFT20(uint32_t input_data);
+void ClrTCLK();
+void SetTCLK();
+void ResetTAP();
+void EnterSBW();
+void EnterJTAG();
+bool GetDevice();
+void ReleaseDevice();
+void ReleaseDeviceAt(uint16_t addr);
+bool SetInstrFetch();
+void SetPC(uint16_t addr);
+void SetPC_430X(uint32_t addr);
+void ExecutePOR();
+void HaltCPU();
+void ReleaseCPU();
+uint16_t ReadCpuReg(int reg);
+void WriteCpuReg(int reg, uint16_t value);
+void ReadCpuRegs(uint16_t *regs);
+void WriteCpuRegs(const uint16_t *regs, uint16_t mask);
+bool StepCPU();
+void QueueReadMem(uint16_t addr, uint16_t *dest);
+uint16_t ReadMem(uint16_t addr);
+void QueueWriteMem(uint16_t addr, uint16_t data);
+void WriteMem(uint16_t addr, uint16_t data);
+uint16_t ReadMem_430X(uint32_t addr);
+void WriteMem_430X(uint32_t addr, uint16_t data);
+void ReadMemQuick(uint16_t addr, uint16_t length, uint16_t *data);
+void WriteMemQuick(uint16_t addr, uint16_t length, const uint16_t *data);
+void ReadMemQuick_430X(uint32_t addr, uint16_t length, uint16_t *data);
+void WriteMemQuick_430X(uint32_t addr, uint16_t length, const uint16_t *data);
+uint16_t PsaSignature(uint16_t addr, uint16_t length, const uint16_t *image);
+bool VerifyPSA(uint16_t addr, uint16_t length, const uint16_t *image);
+bool VerifyPSA_430X(uint32_t addr, uint16_t length, const uint16_t *image);
+bool EraseCheck(uint16_t addr, uint16_t length);
+bool EraseCheck_430X(uint32_t addr, uint16_t length);
+
+/*
+    Loopback check of the JTAG wiring: every IR scan must
+    return JTAG_ID, and 16-bit patterns shifted through
+    bypass must come back one bit late. Only IR_BYPASS is
+    loaded, so it is safe with the CPU under JTAG control.
+*/
+bool CheckLink(void);
+
+/*
+    Steps the TCK rate up until CheckLink fails, then
+    settles one step below the fastest rate that passed
+    every check, as a safety margin. Passing at the top
+    rate, the MSP430 maximum, needs no margin.
+
+    Returns: the rate set, or 0 if even the slowest rate
+    failed, in which case the slowest rate is kept.
+*/
+uint32_t CalibrateTck(void);
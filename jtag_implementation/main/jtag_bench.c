@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "jtag.h"
+#include "jtag_bench.h"
+#include "jtag_engine.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#include "jtag_sim.h"
+#else
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#endif
+
+typedef struct {
+    const char *name;
+    int runs;
+    int words; // memory words moved per run
+    void (*run)(void);
+} bench_t;
+
+static uint16_t block[BENCH_MAX_WORDS];
+
+static void BenchIrShift(void) {
+    IR_SHIFT(IR_BYPASS);
+}
+
+static void BenchDrShift(void) {
+    DR_SHIFT((uint16_t) 0x5A5A);
+}
+
+static void BenchGetDevice(void) {
+    GetDevice();
+}
+
+static void BenchReadMem(void) {
+    ReadMem((uint16_t) BENCH_RAM);
+}
+
+static void BenchWriteMem(void) {
+    WriteMem((uint16_t) BENCH_RAM, (uint16_t) 0xCAFE);
+}
+
+static void BenchWriteQuick(void) {
+    WriteMemQuick((uint16_t) BENCH_RAM, 64, block);
+}
+
+static void BenchVerifyPSA(void) {
+    VerifyPSA((uint16_t) BENCH_CODE, 64, block);
+}
+
+#define BENCH_READ(words) \
+    static void BenchRead##words(void) { \
+        ReadMemQuick((uint16_t) BENCH_CODE, words, block); \
+    }
+BENCH_READ(16)
+BENCH_READ(64)
+BENCH_READ(256)
+BENCH_READ(1024)
+
+static const bench_t benches[] = {
+    {"IR_SHIFT", 10000, 0, BenchIrShift},
+    {"DR_SHIFT", 10000, 0, BenchDrShift},
+    {"GetDevice", 10, 0, BenchGetDevice},
+    {"HaltCPU", 10000, 0, HaltCPU},
+    {"ReadMem", 10000, 1, BenchReadMem},
+    {"WriteMem", 10000, 1, BenchWriteMem},
+    {"ReadQuick16", 1000, 16, BenchRead16},
+    {"ReadQuick64", 1000, 64, BenchRead64},
+    {"ReadQuick256", 200, 256, BenchRead256},
+    {"ReadQuick1024", 50, 1024, BenchRead1024},
+    {"WriteQuick64", 1000, 64, BenchWriteQuick},
+    {"VerifyPSA64", 1000, 64, BenchVerifyPSA},
+};
+
+/*
+    The ESP32 cycle counter wraps after about 17 s at
+    240 MHz, well above the longest benchmark.
+*/
+#if CONFIG_IDF_TARGET_LINUX
+typedef uint64_t ticks_t;
+
+static ticks_t Ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double ElapsedNs(ticks_t start) {
+    return Ticks() - start;
+}
+#else
+typedef uint32_t ticks_t;
+
+static ticks_t Ticks(void) {
+    return esp_cpu_get_cycle_count();
+}
+
+static double ElapsedNs(ticks_t start) {
+    return (uint32_t) (Ticks() - start) * 1000.0 / esp_rom_get_cpu_ticks_per_us();
+}
+#endif
+
+static void Run(const bench_t *bench) {
+#if CONFIG_IDF_TARGET_LINUX
+    SimClearStats();
+#endif
+    uint32_t tck_start = GetTckCycles();
+    ticks_t start = Ticks();
+    for (int i = 0; i < bench->runs; i++) {
+        bench->run();
+    }
+    double ns = ElapsedNs(start);
+    uint32_t tck = GetTckCycles() - tck_start;
+
+    printf("{\"bench\":\"%s\",\"engine\":\"%s\",\"tck_hz\":%lu,\"runs\":%d,"
+           "\"ns_op\":%.1f,\"tck_op\":%.1f,\"words_s\":%.0f",
+           bench->name, GetShiftEngine()->name, (unsigned long) GetTckRate(), bench->runs,
+           ns / bench->runs, (double) tck / bench->runs,
+           bench->words * bench->runs * 1e9 / ns);
+#if CONFIG_IDF_TARGET_LINUX
+    const sim_stats_t *stats = SimStats();
+    printf(",\"pin_writes_op\":%.1f,\"toggles_op\":%.1f",
+           (double) stats->pin_writes / bench->runs, (double) stats->toggles / bench->runs);
+#endif
+    printf("}\n");
+}
+
+void RunBenchmarks(void) {
+    for (int i = 0; i < (int) (sizeof(benches) / sizeof(benches[0])); i++) {
+        Run(&benches[i]);
+    }
+}
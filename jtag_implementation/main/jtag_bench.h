@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+    Benchmarks the JTAG primitives, and quick block reads
+    of several sizes, on the current shift engine. Every
+    result is printed as one JSON line, so results can be
+    picked out of the console log and compared between
+    releases:
+
+    {"bench":"ReadMem","engine":"gpio-fast","tck_hz":0,"runs":10000,
+     "ns_op":812.4,"tck_op":62.0,"words_s":1230910}
+
+    ns/op is taken with the CPU cycle counter on the ESP32
+    and with the monotonic clock in the linux build, which
+    adds the simulator's pin writes and toggles per op.
+    words_s is 0 for primitives that move no memory.
+    Memory at BENCH_RAM is overwritten, so the CPU must be
+    halted; block reads come from BENCH_CODE.
+*/
+
+#define BENCH_RAM 0x0200
+#define BENCH_CODE 0xC000
+#define BENCH_MAX_WORDS 1024 // largest block read
+
+void RunBenchmarks(void);
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <string.h>
+#include "jtag.h"
+#include "jtag_check.h"
+#include "jtag_image.h"
+#include "jtag_queue.h"
+#include "jtag_shadow.h"
+#include "jtag_sim.h"
+#include "jtag_sync.h"
+#include "jtag_tap.h"
+#include "jtag_wave.h"
+
+/*
+    Signatures from the VerifyPSA loop of the SLAU320
+    reference code (POLY 0x0805): six code words at 0xC000,
+    and 32 erased words at 0x1000. The simulated target has
+    to end with the same signature as the host.
+*/
+static bool CheckPsa(void) {
+    static const uint16_t code[] = {0x4031, 0x0A00, 0x40B2, 0x5A80, 0x0120, 0x3FFF};
+    bool ok = PsaSignature(0xC000, 6, code) == 0x6AD5 && PsaSignature(0x1000, 32, NULL) == 0xCCD2;
+    for (int i = 0; i < 6; i++) {
+        SimPoke(0xC000 + 2 * i, code[i]);
+    }
+    ok = ok && VerifyPSA(0xC000, 6, code);
+    printf("Check      PSA %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/*
+    Samples of IR_CNTRL_SIG_16BIT (0x13, LSB first) from an
+    empty sequence, as TMS | TCK << 1 | TDI << 2: Select DR,
+    Select IR, Capture IR, Shift IR, eight bits with TMS on
+    the last, Update and Run/Idle, where the flush ends.
+*/
+static const uint8_t wave_ir_samples[] = {
+    1, 3, 1, 3, 0, 2, 0, 2,
+    4, 6, 4, 6, 0, 2, 0, 2, 4, 6, 0, 2, 0, 2, 1, 3,
+    1, 3, 0, 2,
+};
+
+/*
+    Scans and TCLK changes of ReadMemQuick(0xC000, 2). TCLK
+    starts low, so a ClrTCLK while it is low leaves no trace.
+*/
+#define EVENT_IR(ir) (0x10000 | (ir))
+#define EVENT_DR(dr) (0x20000 | (dr))
+#define EVENT_TCLK(level) (0x30000 | (level))
+
+static const uint32_t wave_quick_events[] = {
+    // SetPC(0xBFFC)
+    EVENT_IR(0x13), EVENT_DR(0x3401), EVENT_IR(0x41), EVENT_DR(0x4030),
+    EVENT_TCLK(1), EVENT_DR(0xBFFC), EVENT_TCLK(0), EVENT_TCLK(1),
+    EVENT_IR(0x84), EVENT_TCLK(0), EVENT_IR(0x13), EVENT_DR(0x2401),
+    // HaltCPU
+    EVENT_IR(0x41), EVENT_DR(0x3FFF), EVENT_IR(0x13), EVENT_DR(0x2409), EVENT_TCLK(1),
+    // quick read of two words
+    EVENT_TCLK(0), EVENT_IR(0x13), EVENT_DR(0x2409), EVENT_IR(0x43),
+    EVENT_TCLK(1), EVENT_TCLK(0), EVENT_DR(0x0000),
+    EVENT_TCLK(1), EVENT_TCLK(0), EVENT_DR(0x0000),
+    // ReleaseCPU
+    EVENT_IR(0x13), EVENT_DR(0x2401), EVENT_IR(0x84), EVENT_TCLK(1),
+};
+
+/*
+    Walks the samples through a TAP and lists the scans
+    (IR values as instructions, LSB first) and the TCLK
+    edges, TDI changes in Run/Idle. The TCK cycle of the
+    first bit of each DR scan goes to dr_cycles.
+
+    Returns: the number of events.
+*/
+static int WaveEvents(const wave_seq_t *seq, uint32_t *events, int max, uint32_t *dr_cycles) {
+    tap_state_t state = TAP_IDLE;
+    int count = 0;
+    int drs = 0;
+    uint32_t cycle = 0;
+    uint32_t value = 0;
+    int bits = 0;
+    int tclk = 0;
+    uint8_t previous = 0;
+    for (size_t i = 0; i < seq->length && count < max; i++) {
+        uint8_t level = seq->samples[i];
+        int tdi = (level & WAVE_TDI) != 0;
+        if (state == TAP_IDLE && tdi != tclk) {
+            tclk = tdi;
+            events[count++] = EVENT_TCLK(tclk);
+        }
+        if (!(previous & WAVE_TCK) && (level & WAVE_TCK)) {
+            if (state == TAP_SHIFT_IR || state == TAP_SHIFT_DR) {
+                if (state == TAP_SHIFT_DR && bits == 0) dr_cycles[drs++] = cycle;
+                value = (value << 1) | tdi;
+                bits++;
+            }
+            state = TapNext(state, level & WAVE_TMS);
+            if (state == TAP_UPDATE_IR) {
+                uint32_t ir = 0;
+                for (int bit = 0; bit < bits; bit++) {
+                    ir |= ((value >> bit) & 0x01) << (bits - 1 - bit);
+                }
+                events[count++] = EVENT_IR(ir);
+            } else if (state == TAP_UPDATE_DR) {
+                events[count++] = EVENT_DR(value);
+            }
+            if (state == TAP_UPDATE_IR || state == TAP_UPDATE_DR) {
+                value = 0;
+                bits = 0;
+            }
+            cycle++;
+        }
+        previous = level;
+    }
+    return count;
+}
+
+/*
+    Compiled waveforms against known samples, and the
+    sequence of ReadMemQuick against the scans it is made
+    of, with each capture on the first TCK cycle of its
+    DR scan.
+*/
+static bool CheckWave(void) {
+    static uint8_t samples[4096];
+    wave_capture_t captures[2];
+    uint16_t words[2];
+    wave_seq_t seq;
+
+    WaveBegin(&seq, samples, sizeof(samples), captures, 2);
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueFlush();
+    bool ok = seq.length == sizeof(wave_ir_samples) && seq.cycles == 14 &&
+              memcmp(samples, wave_ir_samples, sizeof(wave_ir_samples)) == 0;
+    // from Update-IR straight to Shift-DR, as on the pins
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR(0x2409, &words[0]);
+    WaveEnd(&seq);
+    ok = ok && seq.capture_count == 1 && captures[0].cycle == 14 + 16 && captures[0].bits == 16;
+
+    WaveBegin(&seq, samples, sizeof(samples), captures, 2);
+    ReadMemQuick(0xC000, 2, words);
+    WaveEnd(&seq);
+    uint32_t events[64];
+    uint32_t dr_cycles[32];
+    int count = WaveEvents(&seq, events, 64, dr_cycles);
+    int expected = sizeof(wave_quick_events) / sizeof(wave_quick_events[0]);
+    ok = ok && !seq.overflow && count == expected &&
+         memcmp(events, wave_quick_events, sizeof(wave_quick_events)) == 0;
+    // the two reads are DR scans 8 and 9
+    ok = ok && seq.capture_count == 2 && captures[0].dest == &words[0] &&
+         captures[0].cycle == dr_cycles[7] && captures[1].cycle == dr_cycles[8];
+    printf("Check      Wave %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+typedef struct {
+    uint32_t addr[4];
+    uint16_t length[4];
+    int count;
+} runs_t;
+
+static bool RecordRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx) {
+    runs_t *runs = ctx;
+    if (runs->count == 4) return false;
+    runs->addr[runs->count] = addr;
+    runs->length[runs->count++] = length;
+    return true;
+}
+
+/*
+    Image runs split where a main segment ends, and
+    ShadowProgram turns away anything outside flash.
+*/
+static bool CheckImageRuns(void) {
+    static const char text[] = "@C1FC\n01 02 03 04 05 06 07 08\nq\n";
+    static const uint16_t ram[] = {0x1234, 0x5678};
+    runs_t runs = {0};
+    bool ok = ImageParse(text, sizeof(text), RecordRun, &runs) && runs.count == 2 &&
+              runs.addr[0] == 0xC1FC && runs.length[0] == 2 &&
+              runs.addr[1] == 0xC200 && runs.length[1] == 2;
+    ok = ok && !ShadowProgram(0x0200, 2, ram) && !ShadowProgram(0x0FFE, 2, ram);
+    printf("Check      Image runs %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/*
+    Register reads go through the word at CPU_SCRATCH, so
+    it has to hold what it held before once they are done,
+    and peripheral space (0x01FE was used once) stays out
+    of it.
+*/
+static bool CheckScratch(void) {
+    uint16_t regs[CPU_REGS];
+    SimPoke(CPU_SCRATCH, 0xA55A);
+    SimPoke(0x01FE, 0x5AA5);
+    bool ok = ConnectDevice();
+    WriteCpuReg(4, 0x1234);
+    ReadCpuRegs(regs);
+    ok = ok && regs[4] == 0x1234 && ReadCpuReg(4) == 0x1234;
+    ok = ok && SimPeek(CPU_SCRATCH) == 0xA55A && SimPeek(0x01FE) == 0x5AA5;
+    printf("Check      Scratch %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/*
+    The PC goes through the same injections as the other
+    registers, with the JMP before each one moving it. A
+    PC saved and written back has to be where the CPU
+    carries on: here it steps MOV #0x1234, R4 at 0x0200.
+*/
+static bool CheckPc(void) {
+    uint16_t regs[CPU_REGS];
+    SimPoke(0x0200, 0x4034);
+    SimPoke(0x0202, 0x1234);
+    SimPoke(0x0204, 0x3FFF);
+    bool ok = ConnectDevice();
+    SetPC(0x0200);
+    HaltCPU();
+    ReadCpuRegs(regs);
+    ok = ok && regs[0] == 0x0200 && ReadCpuReg(0) == 0x0200;
+    regs[4] = 0;
+    WriteCpuRegs(regs, 0xFFFF);
+    ok = ok && ReadCpuReg(0) == 0x0200 && StepCPU();
+    ok = ok && ReadCpuReg(4) == 0x1234 && ReadCpuReg(0) == 0x0204;
+    printf("Check      PC %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+bool RunChecks(void) {
+    bool ok = CheckPsa();
+    ok = CheckWave() && ok;
+    ok = CheckImageRuns() && ok;
+    ok = CheckScratch() && ok;
+    ok = CheckPc() && ok;
+    return ok;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+    Host checks for the linux target, run before the
+    profiles. Each one holds code to values worked out
+    apart from it, where the simulated target would agree
+    with a wrong assumption because it was written with
+    the same one.
+
+    Returns: false if any check failed.
+*/
+bool RunChecks(void);
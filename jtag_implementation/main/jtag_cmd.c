@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include "jtag.h"
+#include "jtag_cmd.h"
+#include "jtag_flash.h"
+#include "jtag_sync.h"
+
+typedef struct {
+    const link_t *link;
+    uint8_t rx[256];
+    int rx_len;
+    int rx_pos;
+    uint8_t frame[CMD_FRAME_MAX];
+    uint8_t reply[CMD_FRAME_MAX];
+    uint16_t words[CMD_BLOCK_WORDS];
+} server_t;
+
+static server_t server;
+
+static uint16_t Crc16(const uint8_t *data, int length, uint16_t crc) {
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t Get16(const uint8_t *in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint32_t Get32(const uint8_t *in) {
+    return Get16(in) | ((uint32_t) Get16(&in[2]) << 16);
+}
+
+static void Put16(uint8_t *out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+// returns the next byte, or -1 once the link is closed
+static int GetByte(void) {
+    while (server.rx_pos == server.rx_len) {
+        int count = server.link->read(server.rx, sizeof(server.rx), -1);
+        if (count < 0) return -1;
+        server.rx_len = count;
+        server.rx_pos = 0;
+    }
+    return server.rx[server.rx_pos++];
+}
+
+/*
+    Waits for the next frame, skipping anything before its
+    magic, and leaves it in server.frame.
+
+    Returns: CMD_OK, CMD_ERR_CRC, or -1 once the link is
+    closed.
+*/
+static int GetFrame(void) {
+    uint8_t *frame = server.frame;
+    int c = 0;
+    while (true) {
+        while (c != CMD_MAGIC0) {
+            if ((c = GetByte()) < 0) return -1;
+        }
+        if ((c = GetByte()) < 0) return -1;
+        if (c == CMD_MAGIC1) break;
+    }
+    frame[0] = CMD_MAGIC0;
+    frame[1] = CMD_MAGIC1;
+    for (int i = 2; i < 6; i++) {
+        if ((c = GetByte()) < 0) return -1;
+        frame[i] = c;
+    }
+    int length = Get16(&frame[4]);
+    if (length > CMD_MAX_PAYLOAD) return CMD_ERR_CRC;
+    for (int i = 6; i < 6 + length + 2; i++) {
+        if ((c = GetByte()) < 0) return -1;
+        frame[i] = c;
+    }
+    uint16_t crc = Crc16(&frame[2], 4 + length, 0xFFFF);
+    return Get16(&frame[6 + length]) == crc ? CMD_OK : CMD_ERR_CRC;
+}
+
+static void Reply(uint8_t seq, uint8_t op, uint8_t status, int length) {
+    uint8_t *reply = server.reply;
+    reply[0] = CMD_MAGIC0;
+    reply[1] = CMD_MAGIC1;
+    reply[2] = seq;
+    reply[3] = op | CMD_REPLY;
+    Put16(&reply[4], 1 + length);
+    reply[6] = status;
+    Put16(&reply[7 + length], Crc16(&reply[2], 5 + length, 0xFFFF));
+    server.link->write(reply, 9 + length);
+}
+
+static bool IsFlash(uint32_t addr, int words) {
+    return addr >= FLASH_INFO_START && addr + 2 * words <= 0x10000;
+}
+
+/*
+    Runs one command, leaving the data of the reply after
+    its status byte.
+
+    Returns: the status, with *length set to the data bytes.
+*/
+static uint8_t Execute(uint8_t op, const uint8_t *in, int in_length, int *length) {
+    uint8_t *out = &server.reply[7];
+    uint16_t *words = server.words;
+    *length = 0;
+    uint32_t addr = in_length >= 4 ? Get32(in) : 0;
+    int count = in_length >= 6 ? Get16(&in[4]) : 0;
+    bool cpux = addr + 2 * count > 0x10000;
+
+    switch (op) {
+    case CMD_SYNC:
+        return CMD_OK;
+    case CMD_CONNECT:
+        if (!ConnectDevice()) return CMD_ERR_TARGET;
+        out[0] = JTAG_ID;
+        *length = 1;
+        return CMD_OK;
+    case CMD_HALT:
+        if (!GetDevice() || !SetInstrFetch()) return CMD_ERR_TARGET;
+        HaltCPU();
+        return CMD_OK;
+    case CMD_READ:
+        if (in_length != 6 || count > CMD_BLOCK_WORDS) return CMD_ERR_COMMAND;
+        if (cpux) {
+            ReadMemQuick_430X(addr, count, words);
+        } else {
+            ReadMemQuick(addr, count, words);
+        }
+        for (int i = 0; i < count; i++) {
+            Put16(&out[2 * i], words[i]);
+        }
+        *length = 2 * count;
+        return CMD_OK;
+    case CMD_WRITE:
+        count = (in_length - 4) / 2;
+        if (in_length < 4 || (in_length & 1) || count > CMD_BLOCK_WORDS) return CMD_ERR_COMMAND;
+        for (int i = 0; i < count; i++) {
+            words[i] = Get16(&in[4 + 2 * i]);
+        }
+        if (IsFlash(addr, count)) {
+            WriteFLASH(addr, count, words);
+            HaltCPU(); // WriteFLASH leaves the CPU running under JTAG
+        } else if (addr + 2 * count > 0x10000) {
+            WriteMemQuick_430X(addr, count, words);
+        } else {
+            WriteMemQuick(addr, count, words);
+        }
+        return CMD_OK;
+    case CMD_ERASE: {
+        if (in_length != 6) return CMD_ERR_COMMAND;
+        uint16_t mode = Get16(in);
+        addr = Get32(&in[2]);
+        if ((mode != ERASE_SGMT && mode != ERASE_MAIN && mode != ERASE_MASS) ||
+            !IsFlash(addr, 1)) {
+            return CMD_ERR_COMMAND;
+        }
+        EraseFLASH(mode, addr);
+        HaltCPU();
+        return CMD_OK;
+    }
+    case CMD_VERIFY: {
+        if (in_length < 6 || count > CMD_BLOCK_WORDS) return CMD_ERR_COMMAND;
+        bool ok;
+        if (in_length == 6) {
+            ok = cpux ? EraseCheck_430X(addr, count) : EraseCheck(addr, count);
+        } else if (in_length == 6 + 2 * count) {
+            for (int i = 0; i < count; i++) {
+                words[i] = Get16(&in[6 + 2 * i]);
+            }
+            ok = cpux ? VerifyPSA_430X(addr, count, words) : VerifyPSA(addr, count, words);
+        } else {
+            return CMD_ERR_COMMAND;
+        }
+        return ok ? CMD_OK : CMD_ERR_VERIFY;
+    }
+    case CMD_RELEASE:
+        if (in_length == 4) {
+            ReleaseDeviceAt(addr);
+        } else if (in_length == 0) {
+            ReleaseDevice();
+        } else {
+            return CMD_ERR_COMMAND;
+        }
+        return CMD_OK;
+    }
+    return CMD_ERR_COMMAND;
+}
+
+void CmdServe(const link_t *link) {
+    server.link = link;
+    server.rx_len = 0;
+    server.rx_pos = 0;
+    int status;
+    while ((status = GetFrame()) >= 0) {
+        uint8_t seq = server.frame[2];
+        uint8_t op = server.frame[3];
+        int length = 0;
+        if (status == CMD_OK) {
+            status = Execute(op, &server.frame[6], Get16(&server.frame[4]), &length);
+        }
+        Reply(seq, op, status, length);
+    }
+}
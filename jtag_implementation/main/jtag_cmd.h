@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include "jtag_link.h"
+
+/*
+    Binary command protocol, served by the ESP32 for
+    tools/jtag_cli.c. Commands and replies are frames,
+    little endian:
+
+        C3 3C       magic
+        seq    u8   chosen by the host, echoed in the reply
+        op     u8   command; replies carry op | CMD_REPLY
+        length u16  payload bytes, at most CMD_MAX_PAYLOAD
+        payload
+        crc    u16  CRC-16/CCITT of seq through payload
+
+    A reply payload starts with a status byte. Commands
+    run in order, one reply each, so the host may keep up
+    to CMD_WINDOW of them in flight and match the replies
+    by seq instead of waiting for each. Text the console
+    prints between frames is skipped by the host.
+
+    Command payloads and what the reply adds after the
+    status:
+
+        CMD_SYNC     -                     -
+        CMD_CONNECT  -                     JTAG ID; ConnectDevice
+        CMD_HALT     -                     -; control of a running CPU back
+        CMD_READ     addr u32, words u16   the words
+        CMD_WRITE    addr u32, words       -; flash must be erased
+        CMD_ERASE    mode u16, addr u32    -; mode as for EraseFLASH
+        CMD_VERIFY   addr u32, words u16,  -; VerifyPSA, or EraseCheck
+                     [words]                  without the words
+        CMD_RELEASE  [addr u32]            -; reset and run, or run from addr
+
+    Addresses past 64 KB use the 20-bit routines; flash
+    is taken to lie from FLASH_INFO_START up to 64 KB.
+*/
+
+#define CMD_MAGIC0 0xC3
+#define CMD_MAGIC1 0x3C
+#define CMD_REPLY 0x80
+#define CMD_BLOCK_WORDS 256 // most words one command moves
+#define CMD_MAX_PAYLOAD (6 + 2 * CMD_BLOCK_WORDS)
+#define CMD_FRAME_MAX (6 + CMD_MAX_PAYLOAD + 2)
+#define CMD_WINDOW 4 // commands in flight; the ESP32 buffers this many frames
+
+typedef enum {
+    CMD_SYNC,
+    CMD_CONNECT,
+    CMD_HALT,
+    CMD_READ,
+    CMD_WRITE,
+    CMD_ERASE,
+    CMD_VERIFY,
+    CMD_RELEASE,
+} cmd_op_t;
+
+typedef enum {
+    CMD_OK,
+    CMD_ERR_CRC,     // frame damaged on the way
+    CMD_ERR_COMMAND, // unknown op or malformed payload
+    CMD_ERR_TARGET,  // the target did not answer or sync
+    CMD_ERR_VERIFY,  // memory does not match
+} cmd_status_t;
+
+/*
+    Serves commands from link until it closes. Open the
+    link with a receive buffer of CMD_WINDOW *
+    CMD_FRAME_MAX bytes.
+*/
+void CmdServe(const link_t *link);
@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include "jtag.h"
+#include "jtag_dump.h"
+#include "jtag_exec.h"
+
+static uint16_t Crc16(const uint8_t *data, int length, uint16_t crc) {
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static int Put16(uint8_t *out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    return 2;
+}
+
+static int Encode(const uint16_t *words, int count, uint8_t *out) {
+    int size = 0;
+    int literal = -1; // token of the literal run being extended
+    int i = 0;
+    while (i < count) {
+        int run = 1;
+        while (i + run < count && words[i + run] == words[i]) run++;
+        if (run >= DUMP_MIN_RUN) {
+            out[size++] = DUMP_RUN;
+            size += Put16(&out[size], run);
+            size += Put16(&out[size], words[i]);
+            literal = -1;
+            i += run;
+            continue;
+        }
+        if (literal < 0 || out[literal] == 0x7F) {
+            literal = size;
+            out[size++] = 0x00;
+        } else {
+            out[literal]++;
+        }
+        size += Put16(&out[size], words[i]);
+        i++;
+    }
+    return size;
+}
+
+static void WriteFrame(uint32_t addr, const uint16_t *words, int count, dump_write_t write) {
+    uint8_t frame[2 + 8 + DUMP_MAX_PAYLOAD + 2];
+    frame[0] = DUMP_MAGIC0;
+    frame[1] = DUMP_MAGIC1;
+    Put16(&frame[2], addr);
+    Put16(&frame[4], addr >> 16);
+    Put16(&frame[6], count);
+    int size = Encode(words, count, &frame[10]);
+    Put16(&frame[8], size);
+    int length = 10 + size;
+    length += Put16(&frame[length], Crc16(&frame[2], length - 2, 0xFFFF));
+    write(frame, length);
+}
+
+static dump_write_t exec_write;
+
+static void WriteBlock(uint32_t addr, const uint16_t *words, uint16_t length, bool ok) {
+    WriteFrame(addr, words, length, exec_write);
+}
+
+void DumpMemory(uint32_t start_addr, uint32_t stop_addr, dump_write_t write) {
+    bool cpux = stop_addr > 0x10000;
+    uint16_t block[DUMP_BLOCK_WORDS];
+    for (uint32_t addr = start_addr; addr < stop_addr; addr += 2 * DUMP_BLOCK_WORDS) {
+        int count = (stop_addr - addr + 1) / 2;
+        if (count > DUMP_BLOCK_WORDS) count = DUMP_BLOCK_WORDS;
+        if (ExecRunning()) {
+            // the frame goes out while the executor reads the next block
+            exec_write = write;
+            ExecQueue(EXEC_READ, addr, NULL, count, WriteBlock);
+            continue;
+        }
+        if (cpux) {
+            ReadMemQuick_430X(addr, count, block);
+        } else {
+            ReadMemQuick(addr, count, block);
+        }
+        WriteFrame(addr, block, count, write);
+    }
+    if (ExecRunning()) ExecFinish();
+    WriteFrame(stop_addr, block, 0, write);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Binary memory dump. Memory is read in blocks of
+    DUMP_BLOCK_WORDS words and each block goes out as one
+    frame, little endian:
+
+        A5 5A       magic
+        addr   u32  address of the first word
+        words  u16  words in the block, 0 ends the dump
+        size   u16  payload bytes
+        payload     tokens, see below
+        crc    u16  CRC-16/CCITT of addr through payload
+
+    The payload is a list of tokens. 0x00-0x7F is followed
+    by that many words plus one, stored as they are. 0x80
+    is followed by a u16 count and a word repeated count
+    times, which covers erased flash. tools/dump_decode.c
+    turns a captured stream back into a raw image.
+*/
+
+#define DUMP_MAGIC0 0xA5
+#define DUMP_MAGIC1 0x5A
+#define DUMP_BLOCK_WORDS 256
+#define DUMP_RUN 0x80     // token for a repeated word
+#define DUMP_MIN_RUN 3    // shorter repeats are cheaper as literals
+#define DUMP_MAX_PAYLOAD (2 * DUMP_BLOCK_WORDS + DUMP_BLOCK_WORDS / 128 + 5)
+
+typedef void (*dump_write_t)(const uint8_t *data, int length);
+
+/*
+    Dumps memory from start_addr up to stop_addr with quick
+    memory access, ranges past 64 KB with 20-bit addresses
+    like ReadCode, and ends with an empty frame. With the
+    executor running the reads go through it, and each
+    frame is encoded and written while the next block is
+    read.
+*/
+void DumpMemory(uint32_t start_addr, uint32_t stop_addr, dump_write_t write);
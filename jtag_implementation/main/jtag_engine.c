@@ -0,0 +1,364 @@
+#include "jtag_io.h"
+#include "jtag_engine.h"
+#include "jtag_tap.h"
+#include "jtag_trace.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/FreeRTOS.h"
+#endif
+
+#define TMS_MASK PIN_MASK(TMS)
+#define TCK_MASK PIN_MASK(TCK)
+#define TDI_MASK PIN_MASK(TDI)
+#define SBWTCK_MASK PIN_MASK(SBWTCK)
+#define SBWTDIO_MASK PIN_MASK(SBWTDIO)
+
+static uint32_t tck_rate = 0;
+static uint32_t tck_cycles = 0;
+static uint32_t tck_half_ns = 0; // 0: no wait between edges
+
+// holds the current TCK phase for the configured rate
+static inline void TckWait(void) {
+    if (tck_half_ns) DelayNs(tck_half_ns);
+}
+
+static void DriverTms(uint32_t tms, int count) {
+    tck_cycles += count;
+    for (int i = 0; i < count; i++) {
+        PinSet(TMS, (tms >> i) & 0x01);
+        PinSet(TCK, LOW);
+        TracePins();
+        TckWait();
+        PinSet(TCK, HIGH);
+        TracePins();
+        TckWait();
+    }
+}
+
+static uint32_t DriverShift(uint32_t data, int count) {
+    uint32_t ret = 0;
+    tck_cycles += count;
+    for (int i = count - 1; i >= 0; i--) {
+        if (i == 0) PinSet(TMS, HIGH); // 1 (Exit)
+        PinSet(TDI, (data >> i) & 0x01);
+        PinSet(TCK, LOW);
+        TracePins();
+        TckWait();
+        PinSet(TCK, HIGH);
+        TracePins();
+        ret |= (uint32_t) PinGet(TDO) << i;
+        TckWait();
+    }
+    return ret;
+}
+
+static void DriverSetTdi(uint32_t level) {
+    PinSet(TDI, level);
+    TracePins();
+}
+
+static int DriverGetTdi(void) {
+    return PinGet(TDI);
+}
+
+const jtag_engine_t gpio_driver_engine = {
+    .name = "gpio-driver",
+    .tms = DriverTms,
+    .shift = DriverShift,
+    .set_tdi = DriverSetTdi,
+    .get_tdi = DriverGetTdi,
+};
+
+/*
+    On the falling edge TCK is cleared together with any
+    data pin that has to go low, in one W1TC store. Data
+    pins that have to go high are set in a separate store
+    so they settle before the rising edge.
+*/
+static void FastTms(uint32_t tms, int count) {
+    tck_cycles += count;
+    for (int i = 0; i < count; i++) {
+        uint32_t set = ((tms >> i) & 0x01) ? TMS_MASK : 0;
+        PortClr(TCK_MASK | (TMS_MASK & ~set));
+        if (set) PortSet(set);
+        TracePins();
+        TckWait();
+        PortSet(TCK_MASK);
+        TracePins();
+        TckWait();
+    }
+}
+
+static uint32_t FastShift(uint32_t data, int count) {
+    uint32_t ret = 0;
+    tck_cycles += count;
+    for (int i = count - 1; i >= 0; i--) {
+        uint32_t set = ((data >> i) & 0x01) ? TDI_MASK : 0;
+        if (i == 0) set |= TMS_MASK; // 1 (Exit)
+        PortClr(TCK_MASK | (TDI_MASK & ~set));
+        if (set) PortSet(set);
+        TracePins();
+        TckWait();
+        PortSet(TCK_MASK);
+        TracePins();
+        ret |= ((PortIn() >> TDO) & 0x01) << i;
+        TckWait();
+    }
+    return ret;
+}
+
+static void FastSetTdi(uint32_t level) {
+    if (level) {
+        PortSet(TDI_MASK);
+    } else {
+        PortClr(TDI_MASK);
+    }
+    TracePins();
+}
+
+static int FastGetTdi(void) {
+    return (PortOut() >> TDI) & 0x01;
+}
+
+const jtag_engine_t gpio_fast_engine = {
+    .name = "gpio-fast",
+    .tms = FastTms,
+    .shift = FastShift,
+    .set_tdi = FastSetTdi,
+    .get_tdi = FastGetTdi,
+};
+
+/*
+    All data bits but the last go through the SPI
+    peripheral. TCK is dropped before the SPI takes the
+    pin so the handover adds no rising edge. The last bit
+    needs TMS high and is bit-banged like the TMS paths.
+*/
+static uint32_t SpiShift(uint32_t data, int count) {
+    uint32_t ret = 0;
+    if (count > 1) {
+        PortClr(TCK_MASK);
+        SpiAttach();
+        ret = SpiTransfer(data >> 1, count - 1) << 1;
+        tck_cycles += count - 1;
+        SpiDetach();
+    }
+    return ret | FastShift(data & 0x01, 1);
+}
+
+const jtag_engine_t spi_engine = {
+    .name = "spi",
+    .tms = FastTms,
+    .shift = SpiShift,
+    .set_tdi = FastSetTdi,
+    .get_tdi = FastGetTdi,
+};
+
+/*
+    Spy-Bi-Wire. Every TCK cycle is three SBWTCK slots:
+    TMS, TDI and TDO. TMS and TDI are set on SBWTDIO before
+    SBWTCK falls; in the TDO slot SBWTDIO is released just
+    before SBWTCK falls, read just before it rises, and
+    taken back right after. A low phase longer than about
+    7 us resets the target's SBW logic, so the slots of a
+    call run with interrupts off.
+
+    TDI is TCLK in Run/Idle here too, but it only moves
+    with a TCK cycle. The engine follows the TAP to know
+    when set_tdi has to clock an idle cycle (a TCLK edge)
+    and when it only changes the level used in the TDI
+    slots of the cycles to come.
+*/
+#if CONFIG_IDF_TARGET_LINUX
+#define SbwLock()
+#define SbwUnlock()
+#else
+static portMUX_TYPE sbw_mux = portMUX_INITIALIZER_UNLOCKED;
+#define SbwLock() portENTER_CRITICAL(&sbw_mux)
+#define SbwUnlock() portEXIT_CRITICAL(&sbw_mux)
+#endif
+
+static tap_state_t sbw_state = TAP_RESET;
+static int sbw_tclk = HIGH;
+
+static inline void SbwSet(int level) {
+    if (level) {
+        PortSet(SBWTDIO_MASK);
+    } else {
+        PortClr(SBWTDIO_MASK);
+    }
+}
+
+/*
+    TMS slot. Staying in Run/Idle, SBWTDIO goes back to
+    the TCLK level while SBWTCK is low so that TCLK does
+    not glitch (TMSLDH in SLAU320).
+*/
+static inline void SbwTmsSlot(int tms) {
+    SbwSet(tms);
+    PortClr(SBWTCK_MASK);
+    if (!tms && sbw_tclk && sbw_state == TAP_IDLE) PortSet(SBWTDIO_MASK);
+    TckWait();
+    PortSet(SBWTCK_MASK);
+    TckWait();
+}
+
+static inline void SbwTdiSlot(int tdi) {
+    SbwSet(tdi);
+    PortClr(SBWTCK_MASK);
+    TckWait();
+    PortSet(SBWTCK_MASK);
+    TckWait();
+}
+
+static inline uint32_t SbwTdoSlot(void) {
+    PortRelease(SBWTDIO_MASK);
+    PortClr(SBWTCK_MASK);
+    TckWait();
+    uint32_t tdo = (PortIn() >> SBWTDIO) & 0x01;
+    PortSet(SBWTCK_MASK);
+    PortDrive(SBWTDIO_MASK);
+    TckWait();
+    return tdo;
+}
+
+static void SbwTms(uint32_t tms, int count) {
+    tck_cycles += count;
+    SbwLock();
+    for (int i = 0; i < count; i++) {
+        int bit = (tms >> i) & 0x01;
+        SbwTmsSlot(bit);
+        SbwTdiSlot(sbw_tclk);
+        SbwTdoSlot();
+        sbw_state = TapNext(sbw_state, bit);
+    }
+    SbwUnlock();
+}
+
+static uint32_t SbwShift(uint32_t data, int count) {
+    uint32_t ret = 0;
+    tck_cycles += count;
+    SbwLock();
+    for (int i = count - 1; i >= 0; i--) {
+        SbwTmsSlot(i == 0); // 1 (Exit) on the last bit
+        SbwTdiSlot((data >> i) & 0x01);
+        ret |= SbwTdoSlot() << i;
+    }
+    SbwUnlock();
+    sbw_state = TapNext(sbw_state, 1);
+    return ret;
+}
+
+static void SbwSetTdi(uint32_t level) {
+    if (sbw_state != TAP_IDLE) {
+        sbw_tclk = level;
+        return;
+    }
+    tck_cycles++;
+    SbwLock();
+    SbwTmsSlot(LOW);
+    sbw_tclk = level;
+    SbwTdiSlot(level);
+    SbwTdoSlot();
+    SbwUnlock();
+}
+
+static int SbwGetTdi(void) {
+    return sbw_tclk;
+}
+
+const jtag_engine_t sbw_engine = {
+    .name = "sbw",
+    .tms = SbwTms,
+    .shift = SbwShift,
+    .set_tdi = SbwSetTdi,
+    .get_tdi = SbwGetTdi,
+};
+
+static int gang_pins[GANG_MAX] = {TDO};
+static int gang_lanes = 1;
+static uint32_t gang_mask = 0x01;
+static uint32_t gang_results[GANG_MAX];
+
+/*
+    Gang engine: the fast engine's edges with one IN
+    register load per bit, which samples the TDO of every
+    lane at once. The loads are sorted into lanes after the
+    scan so the bit loop is as tight as a single target's.
+*/
+static uint32_t GangShift(uint32_t data, int count) {
+    uint32_t samples[32];
+    tck_cycles += count;
+    for (int i = count - 1; i >= 0; i--) {
+        uint32_t set = ((data >> i) & 0x01) ? TDI_MASK : 0;
+        if (i == 0) set |= TMS_MASK; // 1 (Exit)
+        PortClr(TCK_MASK | (TDI_MASK & ~set));
+        if (set) PortSet(set);
+        TracePins();
+        TckWait();
+        PortSet(TCK_MASK);
+        TracePins();
+        samples[i] = PortIn();
+        TckWait();
+    }
+
+    uint32_t agree = 0;
+    int lead = gang_mask ? __builtin_ctz(gang_mask) : 0;
+    for (int lane = 0; lane < gang_lanes; lane++) {
+        uint32_t ret = 0;
+        for (int i = 0; i < count; i++) {
+            ret |= ((samples[i] >> gang_pins[lane]) & 0x01) << i;
+        }
+        gang_results[lane] = ret;
+    }
+    for (int lane = 0; lane < gang_lanes; lane++) {
+        if (gang_results[lane] == gang_results[lead]) agree |= 1 << lane;
+    }
+    if ((gang_mask & ~agree) == 0) return gang_results[lead];
+    // the lanes disagree: make sure no expected value matches
+    uint32_t bits = count < 32 ? (1UL << count) - 1 : 0xFFFFFFFF;
+    return ~gang_results[lead] & bits;
+}
+
+const jtag_engine_t gang_engine = {
+    .name = "gang",
+    .tms = FastTms,
+    .shift = GangShift,
+    .set_tdi = FastSetTdi,
+    .get_tdi = FastGetTdi,
+};
+
+void SetGangLanes(const int *tdo_pins, int count) {
+    if (count > GANG_MAX) count = GANG_MAX;
+    for (int lane = 0; lane < count; lane++) {
+        gang_pins[lane] = tdo_pins[lane];
+    }
+    gang_lanes = count;
+    gang_mask = (1UL << count) - 1;
+}
+
+void SetGangMask(uint32_t mask) {
+    gang_mask = mask;
+}
+
+uint32_t GetGangMask(void) {
+    return gang_mask;
+}
+
+uint32_t GetGangResult(int lane) {
+    return gang_results[lane];
+}
+
+void SetTckRate(uint32_t hz) {
+    tck_rate = hz;
+    tck_half_ns = hz ? 500000000 / hz : 0;
+    if (hz) SpiSetClock(hz);
+}
+
+uint32_t GetTckRate(void) {
+    return tck_rate;
+}
+
+uint32_t GetTckCycles(void) {
+    return tck_cycles;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    A shift engine moves bits between the ESP32 and the
+    MSP430 TAP. IR_SHIFT, DR_SHIFT and the TCLK routines
+    are written against this interface, so the way the
+    pins are driven can be swapped at runtime.
+*/
+typedef struct {
+    const char *name;
+
+    /*
+        Clocks count TCK cycles with TMS taken from tms,
+        LSB first. TDI is left unchanged.
+    */
+    void (*tms)(uint32_t tms, int count);
+
+    /*
+        Shifts count bits of data, MSB first, through TDI
+        while in a Shift-IR/DR state. TMS is raised on the
+        last bit so the TAP leaves through Exit1. TDO is
+        captured the same way, first bit into the MSB.
+    */
+    uint32_t (*shift)(uint32_t data, int count);
+
+    // Drives TDI, which is TCLK in Run/Idle
+    void (*set_tdi)(uint32_t level);
+    int (*get_tdi)(void);
+
+    /*
+        For engines that only see TDO later, like the
+        waveform compiler: takes where the TDO of the next
+        shift, bits long, goes (size bytes, order a
+        bit_order_t), and the engine fills it in itself.
+        NULL for engines whose shift returns TDO.
+    */
+    void (*capture)(void *dest, int size, int bits, int order);
+} jtag_engine_t;
+
+/*
+    Bit-bangs through gpio_set_level/gpio_get_level. Slow,
+    but every access is checked by the driver; kept as the
+    fallback path.
+*/
+extern const jtag_engine_t gpio_driver_engine;
+
+/*
+    Bit-bangs through the GPIO W1TS/W1TC registers with one
+    store per edge and samples TDO with one IN register
+    load. This is the default engine.
+*/
+extern const jtag_engine_t gpio_fast_engine;
+
+/*
+    Shifts the data bits of a scan through the SPI
+    peripheral and bit-bangs the TMS paths around them
+    like gpio_fast_engine. SpiInit must succeed before
+    this engine is selected.
+*/
+extern const jtag_engine_t spi_engine;
+
+/*
+    Spy-Bi-Wire over SBWTCK and SBWTDIO, for boards that
+    only route the two-wire interface. The target must
+    have been put in SBW mode with EnterSBW. TCK rates
+    apply to SBWTCK, which runs three slots per TCK.
+*/
+extern const jtag_engine_t sbw_engine;
+
+#define GANG_MAX 8 // targets on shared TMS, TCK and TDI lines
+
+/*
+    Gang programming engine, bit-banged like
+    gpio_fast_engine. Every target (lane) shares TMS, TCK
+    and TDI and has its own TDO pin, set with
+    SetGangLanes, so writes reach all targets at once. A
+    scan returns the TDO of the lowest lane in the gang
+    mask if every lane in the mask returned the same, and
+    that value inverted otherwise, so that any check
+    against an expected value fails unless all lanes pass.
+    A mask of one lane checks that lane alone.
+*/
+extern const jtag_engine_t gang_engine;
+
+// lane 0 is tdo_pins[0]; all lanes go in the mask, at most GANG_MAX
+void SetGangLanes(const int *tdo_pins, int count);
+void SetGangMask(uint32_t mask);
+uint32_t GetGangMask(void);
+
+// TDO of a lane in the last scan, in the order shift returns it
+uint32_t GetGangResult(int lane);
+
+void SetShiftEngine(const jtag_engine_t *engine);
+const jtag_engine_t *GetShiftEngine(void);
+
+/*
+    Sets the TCK rate in Hz for every engine. Bit-banged
+    edges are held for at least half a period, on top of
+    the time the stores take, and the SPI clock is set to
+    the rate. 0 lets bit-banged edges run as fast as the
+    pins toggle and leaves the SPI clock as it is.
+*/
+void SetTckRate(uint32_t hz);
+uint32_t GetTckRate(void);
+
+/*
+    TCK cycles clocked by the engines so far, for
+    benchmarks. Wraps at 2^32; waveforms are not counted.
+*/
+uint32_t GetTckCycles(void);
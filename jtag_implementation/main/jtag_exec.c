@@ -0,0 +1,124 @@
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "jtag.h"
+#include "jtag_exec.h"
+#include "jtag_shadow.h"
+
+typedef struct {
+    uint8_t op;
+    bool ok;
+    uint16_t length;
+    uint32_t addr;
+    exec_done_t done;
+    uint16_t words[EXEC_BLOCK_WORDS];
+} exec_slot_t;
+
+static exec_slot_t slots[EXEC_SLOTS];
+static uint32_t submitted = 0; // written by the host task only
+static uint32_t executed = 0;  // written by the executor only
+static uint32_t reaped = 0;    // host task only
+static bool failed = false;    // host task only
+static TaskHandle_t exec_task = NULL;
+static TaskHandle_t host_task = NULL;
+
+static bool Run(exec_slot_t *slot) {
+    bool cpux = slot->addr + 2 * slot->length > 0x10000;
+    switch (slot->op) {
+    case EXEC_READ:
+        if (cpux) {
+            ReadMemQuick_430X(slot->addr, slot->length, slot->words);
+        } else {
+            ReadMemQuick(slot->addr, slot->length, slot->words);
+        }
+        return true;
+    case EXEC_WRITE:
+        if (cpux) {
+            WriteMemQuick_430X(slot->addr, slot->length, slot->words);
+        } else {
+            WriteMemQuick(slot->addr, slot->length, slot->words);
+        }
+        return true;
+    case EXEC_PROGRAM:
+        return !cpux && ShadowProgram(slot->addr, slot->length, slot->words);
+    }
+    return false;
+}
+
+static void ExecTask(void *arg) {
+    while (true) {
+        if (executed == __atomic_load_n(&submitted, __ATOMIC_ACQUIRE)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        exec_slot_t *slot = &slots[executed % EXEC_SLOTS];
+        slot->ok = Run(slot);
+        __atomic_store_n(&executed, executed + 1, __ATOMIC_RELEASE);
+        xTaskNotifyGive(host_task);
+    }
+}
+
+// takes back the oldest command, waiting for it if need be
+static void Reap(void) {
+    while (reaped == __atomic_load_n(&executed, __ATOMIC_ACQUIRE)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    exec_slot_t *slot = &slots[reaped % EXEC_SLOTS];
+    failed |= !slot->ok;
+    if (slot->done != NULL) slot->done(slot->addr, slot->words, slot->length, slot->ok);
+    reaped++;
+}
+
+bool ExecStart(void) {
+    if (exec_task != NULL) return true;
+    host_task = xTaskGetCurrentTaskHandle();
+    return xTaskCreatePinnedToCore(ExecTask, "jtag_exec", 4096, NULL, EXEC_PRIORITY, &exec_task,
+                                   EXEC_CORE) == pdPASS;
+}
+
+void ExecStop(void) {
+    if (exec_task == NULL) return;
+    ExecFinish();
+    vTaskDelete(exec_task);
+    exec_task = NULL;
+}
+
+bool ExecRunning(void) {
+    return exec_task != NULL;
+}
+
+bool ExecQueue(exec_op_t op, uint32_t addr, const uint16_t *words, uint16_t length,
+               exec_done_t done) {
+    for (uint32_t i = 0; i < length; i += EXEC_BLOCK_WORDS) {
+        if (submitted - reaped == EXEC_SLOTS) Reap();
+        exec_slot_t *slot = &slots[submitted % EXEC_SLOTS];
+        slot->op = op;
+        slot->addr = addr + 2 * i;
+        slot->length = length - i < EXEC_BLOCK_WORDS ? length - i : EXEC_BLOCK_WORDS;
+        slot->done = done;
+        if (words != NULL) memcpy(slot->words, &words[i], 2 * slot->length);
+        if (exec_task == NULL) {
+            // no executor, the host task runs the command itself
+            slot->ok = Run(slot);
+            submitted++;
+            executed++;
+            Reap();
+            continue;
+        }
+        __atomic_store_n(&submitted, submitted + 1, __ATOMIC_RELEASE);
+        xTaskNotifyGive(exec_task);
+    }
+    return !failed;
+}
+
+bool ExecFinish(void) {
+    while (reaped != submitted) Reap();
+    bool ok = !failed;
+    failed = false;
+    return ok;
+}
+
+bool ExecProgramRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx) {
+    return ExecQueue(EXEC_PROGRAM, addr, words, length, NULL);
+}
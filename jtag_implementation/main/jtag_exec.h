@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "jtag_image.h"
+
+/*
+    Pipelined JTAG executor. A task pinned to EXEC_CORE
+    runs memory commands handed over by one host task
+    through EXEC_SLOTS slots, each with its own data block.
+    While the executor shifts one block, the host task
+    fills or drains the other, so JTAG, host I/O and image
+    decoding overlap instead of adding up.
+
+    The slots form a lock-free single-producer
+    single-consumer ring: the host task only advances the
+    submit and reap counts, the executor only the done
+    count, and each side wakes the other with a task
+    notification. Nothing else is pinned to EXEC_CORE and
+    interrupts are allocated on the core that installs
+    them, so at EXEC_PRIORITY the executor shifts with
+    little but the tick to preempt it.
+
+    Once the executor is started only it may drive JTAG:
+    the host task calls ExecFinish before scanning itself.
+    Without the executor, commands run inline on the host
+    task.
+*/
+
+#define EXEC_SLOTS 2 // blocks in flight, double buffered; a power of 2
+#define EXEC_BLOCK_WORDS IMAGE_RUN_WORDS
+#define EXEC_CORE (portNUM_PROCESSORS - 1) // app_main and the drivers stay on core 0
+#define EXEC_PRIORITY (configMAX_PRIORITIES - 2)
+
+typedef enum {
+    EXEC_READ,    // ReadMemQuick into the block
+    EXEC_WRITE,   // WriteMemQuick from the block
+    EXEC_PROGRAM, // ShadowProgram from the block, 16-bit addresses only
+} exec_op_t;
+
+/*
+    Called by the host task once a command is done, with
+    the data read for EXEC_READ.
+*/
+typedef void (*exec_done_t)(uint32_t addr, const uint16_t *words, uint16_t length, bool ok);
+
+/*
+    Starts the executor. The calling task becomes the host
+    task, the only one that may queue commands.
+
+    Returns: false if the task could not be created.
+*/
+bool ExecStart(void);
+
+/*
+    Waits for the queued commands, then deletes the
+    executor, handing JTAG back to the host task.
+*/
+void ExecStop(void);
+
+bool ExecRunning(void);
+
+/*
+    Queues a command on length words at addr, split into
+    blocks of EXEC_BLOCK_WORDS. words, if not NULL, is
+    copied, so the caller may reuse it at once. Waits for
+    a free slot when all are in flight, running the done
+    callbacks of the commands it takes back.
+
+    Returns: false if a command failed since the last
+    ExecFinish, so callers can stop early.
+*/
+bool ExecQueue(exec_op_t op, uint32_t addr, const uint16_t *words, uint16_t length,
+               exec_done_t done);
+
+/*
+    Waits for every queued command and runs the remaining
+    done callbacks.
+
+    Returns: false if a command failed since the last
+    ExecFinish.
+*/
+bool ExecFinish(void);
+
+/*
+    Image sink that queues each run as EXEC_PROGRAM, so
+    the next run is decoded while this one is programmed.
+    Call ExecFinish after the parse for the result.
+*/
+bool ExecProgramRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx);
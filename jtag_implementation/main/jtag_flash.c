@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include "jtag.h"
+#include "jtag_engine.h"
+#include "jtag_flash.h"
+#include "jtag_io.h"
+#include "jtag_queue.h"
+
+#define FCTL1 0x0128
+#define FCTL2 0x012A
+#define FCTL3 0x012C
+
+#define FCTL1_OFF 0xA500
+#define FCTL1_WRT 0xA540
+#define FCTL1_BLKWRT 0xA5C0
+
+// timing generator cycles, F1xx figures which also cover later families
+#define STROBES_BLOCK_FIRST 30
+#define STROBES_BLOCK_NEXT 21
+#define STROBES_BLOCK_END 6
+#define STROBES_SEGMENT 4820
+#if FLASH_FAST
+#define STROBES_MASS 10600
+#define MASS_LOOPS 1
+#else
+#define STROBES_MASS 5300
+#define MASS_LOOPS 19
+#endif
+
+/*
+    Queues a JTAG write of data to addr. RW must already
+    be set to write.
+*/
+static void QueueStore(uint16_t addr, uint16_t data) {
+    QueueIR(IR_ADDR_16BIT);
+    QueueDR(addr, NULL);
+    QueueIR(IR_DATA_TO_ADDR);
+    QueueDR(data, NULL);
+    QueueSetTCLK();
+    QueueClrTCLK();
+}
+
+static void QueueWriteMode(void) {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2408, NULL); // set RW to write
+}
+
+/*
+    Gives the timing generator count TCLK cycles at
+    FLASH_TCLK_HZ. RW is set to read first so that the
+    strobes do not repeat the last write.
+*/
+static void TCLKstrobes(int count) {
+    QueueIR(IR_CNTRL_SIG_16BIT);
+    QueueDR((uint16_t) 0x2409, NULL); // set RW to read
+    QueueFlush();
+
+    const jtag_engine_t *engine = GetShiftEngine();
+    uint32_t half_period = 1000000000 / (2 * FLASH_TCLK_HZ);
+    for (int i = 0; i < count; i++) {
+        engine->set_tdi(HIGH);
+        DelayNs(half_period);
+        engine->set_tdi(LOW);
+        DelayNs(half_period);
+    }
+}
+
+static void FlashUnlock(uint16_t fctl1) {
+    HaltCPU();
+    QueueClrTCLK();
+    QueueWriteMode();
+    QueueStore(FCTL1, fctl1);
+    QueueStore(FCTL2, 0xA540); // MCLK as source, DIV = 1
+    QueueStore(FCTL3, 0xA500); // clear LOCK, info segment A stays locked
+}
+
+static void FlashLock(void) {
+    QueueWriteMode();
+    QueueStore(FCTL1, FCTL1_OFF);
+    QueueStore(FCTL3, 0xA510); // set LOCK again
+    QueueFlush();
+}
+
+void EraseFLASH(uint16_t erase_mode, uint16_t erase_addr) {
+    int strobes = STROBES_SEGMENT;
+    int loops = 1;
+    if (erase_mode != ERASE_SGMT) {
+        strobes = STROBES_MASS;
+        loops = MASS_LOOPS;
+    }
+    for (int i = 0; i < loops; i++) {
+        FlashUnlock(erase_mode);
+        QueueStore(erase_addr, 0x55AA); // dummy write starts the erase
+        TCLKstrobes(strobes);
+        FlashLock();
+    }
+    ReleaseCPU();
+}
+
+void WriteFLASH(uint16_t addr, uint16_t length, const uint16_t *data) {
+    FlashUnlock(FCTL1_WRT);
+    uint16_t i = 0;
+    while (i < length) {
+        if (data[i] == 0xFFFF) {
+            i++;
+            continue;
+        }
+        uint32_t block_end = (((uint32_t) addr + 2 * i) | (FLASH_BLOCK - 1)) + 1;
+        QueueWriteMode();
+        QueueStore(FCTL1, FCTL1_BLKWRT);
+        int strobes = STROBES_BLOCK_FIRST;
+        while (i < length && data[i] != 0xFFFF && (uint32_t) addr + 2 * i < block_end) {
+            QueueWriteMode();
+            QueueStore(addr + 2 * i, data[i]);
+            TCLKstrobes(strobes);
+            strobes = STROBES_BLOCK_NEXT;
+            i++;
+        }
+        // clearing BLKWRT ends the block
+        QueueWriteMode();
+        QueueStore(FCTL1, FCTL1_WRT);
+        TCLKstrobes(STROBES_BLOCK_END);
+    }
+    FlashLock();
+    ReleaseCPU();
+}
+
+/*
+    Erases the segments that [addr, addr + 2 * length)
+    touches and are not blank already.
+*/
+static void EraseSegments(uint16_t addr, uint16_t length) {
+    uint32_t end = addr + 2 * length;
+    uint32_t segment = addr;
+    while (segment < end) {
+        uint32_t size = segment < FLASH_MAIN_START ? FLASH_INFO_SEGMENT : FLASH_MAIN_SEGMENT;
+        uint32_t start = segment & ~(size - 1);
+        uint32_t next = start + size;
+        // main memory starts in the middle of a segment
+        if (start < FLASH_MAIN_START && segment >= FLASH_MAIN_START) start = FLASH_MAIN_START;
+        if (!EraseCheck(start, (next - start) / 2)) {
+            EraseFLASH(ERASE_SGMT, start);
+        }
+        segment = next;
+    }
+}
+
+bool ProgramFLASH(uint16_t addr, uint16_t length, const uint16_t *data) {
+    EraseSegments(addr, length);
+    WriteFLASH(addr, length, data);
+    return VerifyPSA(addr, length, data);
+}
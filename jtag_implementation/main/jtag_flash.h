@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Flash erase and programming for devices with the
+    flash controller of the F1xx/F2xx/F4xx families,
+    following the JTAG flows of SLAU320. The CPU is halted
+    throughout and the flash timing generator runs from
+    MCLK, which is TCLK under JTAG, so every erase and
+    write is timed by TCLK strobes at FLASH_TCLK_HZ.
+*/
+
+#define ERASE_SGMT 0xA502 // one segment
+#define ERASE_MAIN 0xA504 // all of main memory
+#define ERASE_MASS 0xA506 // main and information memory
+
+#define FLASH_TCLK_HZ 350000 // the timing generator needs 257 to 476 kHz
+#define FLASH_FAST 1         // F2xx/F4xx flash; 0 for F1xx, whose mass erase is repeated
+
+#define FLASH_INFO_START 0x1000
+#define FLASH_MAIN_START 0x1100
+#define FLASH_INFO_SEGMENT 64  // bytes; an F1xx erases 128 at a time
+#define FLASH_MAIN_SEGMENT 512
+#define FLASH_BLOCK 64         // a block write must stay within one block
+
+/*
+    Erases the segment holding erase_addr (ERASE_SGMT),
+    or all of main or all flash memory, in which case
+    erase_addr is any address in main memory.
+*/
+void EraseFLASH(uint16_t erase_mode, uint16_t erase_addr);
+
+/*
+    Programs length words from addr with block writes.
+    Words equal to 0xFFFF are erased already and are left
+    out, splitting the blocks around them. The target
+    range must be erased.
+*/
+void WriteFLASH(uint16_t addr, uint16_t length, const uint16_t *data);
+
+/*
+    Erases every segment the image touches, unless
+    EraseCheck finds it blank already, then writes the
+    image and checks it with VerifyPSA. Data elsewhere in
+    those segments is lost.
+
+    Returns: true if the flash matches the image.
+*/
+bool ProgramFLASH(uint16_t addr, uint16_t length, const uint16_t *data);
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include "jtag.h"
+#include "jtag_engine.h"
+#include "jtag_flash.h"
+#include "jtag_gang.h"
+#include "jtag_io.h"
+
+static gang_status_t status[GANG_MAX];
+static int gang_count = 0;
+static uint32_t ready = 0; // targets still in the gang
+
+/*
+    Targets in mask whose result of the last scan has all
+    of bits set.
+*/
+static uint32_t WithBits(uint32_t mask, uint16_t bits) {
+    uint32_t found = 0;
+    for (int target = 0; target < gang_count; target++) {
+        if (((mask >> target) & 0x01) && (GetGangResult(target) & bits) == bits) {
+            found |= 1UL << target;
+        }
+    }
+    return found;
+}
+
+bool GangInit(const int *tdo_pins, int count) {
+    if (count < 1 || count > GANG_MAX) {
+        printf("Gang: %d targets, 1 to %d supported\n", count, GANG_MAX);
+        return false;
+    }
+    for (int target = 0; target < count; target++) {
+        if (tdo_pins[target] != TDO) PinInitTdo(tdo_pins[target]);
+        status[target] = (gang_status_t) {0};
+    }
+    gang_count = count;
+    ready = 0;
+    SetGangLanes(tdo_pins, count);
+    SetShiftEngine(&gang_engine);
+    return true;
+}
+
+uint32_t GangConnect(void) {
+    SetGangMask((1UL << gang_count) - 1);
+    ResetTAP();
+    IR_SHIFT(IR_CNTRL_SIG_16BIT);
+    uint32_t found = 0;
+    for (int target = 0; target < gang_count; target++) {
+        status[target] = (gang_status_t) {.fuse_ok = GetGangResult(target) == JTAG_ID};
+        if (status[target].fuse_ok) found |= 1UL << target;
+    }
+    ready = 0;
+    if (found == 0) return 0;
+
+    // GetDevice and SetInstrFetch, with every target watched on its own
+    SetGangMask(found);
+    DR_SHIFT((uint16_t) 0x2401);
+    IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
+    uint32_t synced = 0;
+    for (int i = 0; i < GANG_SYNC_POLLS && synced != found; i++) {
+        DR_SHIFT((uint16_t) 0x0000);
+        synced |= WithBits(found, 0x0200);
+    }
+    uint32_t fetch = 0;
+    for (int i = 0; i < 8 && fetch != synced; i++) {
+        DR_SHIFT((uint16_t) 0x0000);
+        fetch |= WithBits(synced, 0x0080);
+        if (fetch != synced) {
+            ClrTCLK();
+            SetTCLK();
+        }
+    }
+
+    ready = fetch;
+    SetGangMask(ready);
+    if (ready != 0) HaltCPU();
+    for (int target = 0; target < gang_count; target++) {
+        status[target].synced = (ready >> target) & 0x01;
+    }
+    return ready;
+}
+
+uint32_t GangProgram(uint16_t addr, uint16_t length, const uint16_t *data) {
+    if (ready == 0) return 0;
+    SetGangMask(ready);
+    uint32_t verified = ready;
+    if (!ProgramFLASH(addr, length, data)) {
+        verified = 0;
+        for (int target = 0; target < gang_count; target++) {
+            if (!((ready >> target) & 0x01)) continue;
+            SetGangMask(1UL << target);
+            if (VerifyPSA(addr, length, data)) verified |= 1UL << target;
+        }
+    }
+    for (int target = 0; target < gang_count; target++) {
+        if ((ready >> target) & 0x01) status[target].verified = (verified >> target) & 0x01;
+    }
+    ready = verified;
+    SetGangMask(ready);
+    return verified;
+}
+
+const gang_status_t *GangStatus(int target) {
+    return &status[target];
+}
+
+void GangReport(void) {
+    for (int target = 0; target < gang_count; target++) {
+        const gang_status_t *s = &status[target];
+        printf("Target %d: fuse %s, sync %s, verify %s\n", target,
+               s->fuse_ok ? "ok" : "FAIL", s->synced ? "ok" : "FAIL",
+               s->verified ? "ok" : "FAIL");
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "jtag_engine.h"
+
+/*
+    Gang programming: targets wired to shared TMS, TCK and
+    TDI lines, each with its own TDO pin, are programmed
+    together in about the time one takes. Fuse check, sync
+    and verify results are kept per target, and a target
+    that fails a step is dropped from the gang while the
+    others carry on.
+*/
+
+#define GANG_SYNC_POLLS 50 // control signal reads waiting for a target to sync
+
+typedef struct {
+    bool fuse_ok;  // JTAG ID read after the fuse check: wired, powered, fuse intact
+    bool synced;   // CPU under JTAG control and halted
+    bool verified; // flash matched the image of the last GangProgram
+} gang_status_t;
+
+/*
+    Sets up one TDO pin per target, the first usually TDO,
+    and selects gang_engine. Run the 4-wire entry sequence
+    first, as for a single target.
+
+    Returns: false, with nothing changed, if count is not
+    1 to GANG_MAX.
+*/
+bool GangInit(const int *tdo_pins, int count);
+
+/*
+    Resets the TAPs with a fuse check, then syncs and halts
+    every target that answered with the JTAG ID.
+
+    Returns: mask of the targets under JTAG control.
+*/
+uint32_t GangConnect(void);
+
+/*
+    Programs flash on every target still in the gang at
+    once with ProgramFLASH. Segments are erased unless they
+    are blank on all targets. When the final PSA check
+    fails, each target is verified on its own to find the
+    ones that did not take the image.
+
+    Returns: mask of the targets that verified.
+*/
+uint32_t GangProgram(uint16_t addr, uint16_t length, const uint16_t *data);
+
+const gang_status_t *GangStatus(int target);
+
+// prints one line of status per target
+void GangReport(void);
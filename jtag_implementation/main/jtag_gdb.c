@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <string.h>
+#include "jtag.h"
+#include "jtag_gdb.h"
+#include "jtag_queue.h"
+#include "jtag_shadow.h"
+
+typedef struct {
+    const link_t *link;
+    uint8_t rx[256];
+    int rx_len;
+    int rx_pos;
+    bool closed;
+    uint16_t regs[CPU_REGS];
+    bool regs_valid;
+    uint16_t regs_dirty; // one bit per register
+    char packet[GDB_PACKET_SIZE + 1];
+    char reply[GDB_PACKET_SIZE + 1];
+} gdb_t;
+
+static gdb_t gdb;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// returns the next byte, -1 on timeout, or -2 once the link is closed
+static int GetByte(int timeout_ms) {
+    if (gdb.rx_pos == gdb.rx_len) {
+        int count = gdb.link->read(gdb.rx, sizeof(gdb.rx), timeout_ms);
+        if (count < 0) gdb.closed = true;
+        if (count <= 0) return count < 0 ? -2 : -1;
+        gdb.rx_len = count;
+        gdb.rx_pos = 0;
+    }
+    return gdb.rx[gdb.rx_pos++];
+}
+
+static int HexValue(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// parses hex digits at *p, leaving *p on the first other character
+static uint32_t ParseHex(const char **p) {
+    uint32_t value = 0;
+    while (HexValue(**p) >= 0) {
+        // saturates, so an overlong number cannot wrap into range
+        value = value > 0x0FFFFFFF ? 0xFFFFFFFF : (value << 4) | HexValue(**p);
+        (*p)++;
+    }
+    return value;
+}
+
+static char *PutHexByte(char *out, uint8_t value) {
+    *out++ = hex_digits[value >> 4];
+    *out++ = hex_digits[value & 0x0F];
+    return out;
+}
+
+static int ParseHexByte(const char *p) {
+    int high = HexValue(p[0]);
+    int low = high < 0 ? -1 : HexValue(p[1]);
+    return low < 0 ? -1 : (high << 4) | low;
+}
+
+/*
+    Waits for the next packet and acknowledges it.
+
+    Returns: its length, or -1 once the link is closed.
+*/
+static int GetPacket(void) {
+    while (true) {
+        int c;
+        do {
+            c = GetByte(-1);
+            if (c == -2) return -1;
+        } while (c != '$');
+
+        int length = 0;
+        uint8_t sum = 0;
+        while ((c = GetByte(-1)) != '#') {
+            if (c == -2) return -1;
+            if (c == '$') {
+                // a resend started over
+                length = 0;
+                sum = 0;
+                continue;
+            }
+            if (length < GDB_PACKET_SIZE) gdb.packet[length++] = c;
+            sum += c;
+        }
+        int high = GetByte(-1);
+        int low = GetByte(-1);
+        if (low == -2) return -1;
+        gdb.packet[length] = '\0';
+        char check[2] = {high, low};
+        uint8_t ack = ParseHexByte(check) == sum ? '+' : '-';
+        gdb.link->write(&ack, 1);
+        if (ack == '+') return length;
+    }
+}
+
+/*
+    Sends a packet and waits for GDB to acknowledge it,
+    resending on a '-'.
+*/
+static void PutPacket(const char *data) {
+    int length = strlen(data);
+    uint8_t sum = 0;
+    for (int i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    char trailer[3] = {'#', hex_digits[sum >> 4], hex_digits[sum & 0x0F]};
+    for (int tries = 0; tries < 3; tries++) {
+        gdb.link->write((const uint8_t *) "$", 1);
+        gdb.link->write((const uint8_t *) data, length);
+        gdb.link->write((const uint8_t *) trailer, 3);
+        int c;
+        do {
+            c = GetByte(1000);
+        } while (c >= 0 && c != '+' && c != '-');
+        if (c != '-') return;
+    }
+}
+
+static void LoadRegs(void) {
+    if (gdb.regs_valid) return;
+    ReadCpuRegs(gdb.regs);
+    gdb.regs_valid = true;
+    gdb.regs_dirty = 0;
+}
+
+static void SetReg(int reg, uint16_t value) {
+    if (reg == 3 || gdb.regs[reg] == value) return;
+    gdb.regs[reg] = value;
+    gdb.regs_dirty |= 1 << reg;
+}
+
+/*
+    Writes memory and the registers GDB changed back to
+    the target, except the PC, which the caller loads.
+*/
+static void WriteBack(void) {
+    LoadRegs();
+    if (!ShadowFlush()) printf("GDB: flash write failed to verify\n");
+    HaltCPU(); // flash programming leaves the CPU running under JTAG
+    WriteCpuRegs(gdb.regs, gdb.regs_dirty & ~1);
+    gdb.regs_dirty = 0;
+}
+
+// RAM and registers go stale once the CPU has run
+static void Ran(void) {
+    ShadowInvalidate();
+    gdb.regs_valid = false;
+}
+
+/*
+    Reads count words from addr: peripherals in one queue
+    flush, the rest through the shadow.
+*/
+static void ReadWords(uint16_t addr, int count, uint16_t *words) {
+    int i = 0;
+    bool queued = false;
+    for (; i < count && (uint32_t) addr + 2 * i < SHADOW_START; i++) {
+        QueueReadMem(addr + 2 * i, &words[i]);
+        queued = true;
+    }
+    if (queued) QueueFlush();
+    for (; i < count; i++) {
+        words[i] = ShadowReadMem(addr + 2 * i);
+    }
+}
+
+// m addr,length
+static void ReadMemory(const char *p) {
+    uint32_t addr = ParseHex(&p);
+    if (*p++ != ',') {
+        PutPacket("E01");
+        return;
+    }
+    uint32_t length = ParseHex(&p);
+    if (length > GDB_PACKET_SIZE / 2) length = GDB_PACKET_SIZE / 2;
+    // addr comes from the client, so addr + length could wrap
+    if (addr >= 0x10000 || length > 0x10000 - addr) {
+        PutPacket("E02");
+        return;
+    }
+    uint16_t words[GDB_PACKET_SIZE / 4 + 1];
+    uint32_t first = addr & ~1;
+    int count = (addr + length - first + 1) / 2;
+    ReadWords(first, count, words);
+    char *out = gdb.reply;
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t byte = addr + i - first;
+        out = PutHexByte(out, words[byte / 2] >> (8 * (byte & 1)));
+    }
+    *out = '\0';
+    PutPacket(gdb.reply);
+}
+
+// M addr,length:data
+static void WriteMemory(const char *p) {
+    uint32_t addr = ParseHex(&p);
+    if (*p++ != ',') {
+        PutPacket("E01");
+        return;
+    }
+    uint32_t length = ParseHex(&p);
+    if (*p++ != ':' || strlen(p) < 2 * length) {
+        PutPacket("E01");
+        return;
+    }
+    // addr comes from the client, so addr + length could wrap
+    if (addr >= 0x10000 || length > 0x10000 - addr) {
+        PutPacket("E02");
+        return;
+    }
+    uint32_t i = 0;
+    while (i < length) {
+        uint16_t word_addr = (addr + i) & ~1;
+        uint16_t word = 0;
+        // a byte on its own keeps the other half of its word
+        if (((addr + i) & 1) || i + 1 == length) {
+            ReadWords(word_addr, 1, &word);
+        }
+        for (int half = (addr + i) & 1; half < 2 && i < length; half++, i++) {
+            int value = ParseHexByte(&p[2 * i]);
+            if (value < 0) {
+                PutPacket("E01");
+                return;
+            }
+            word = (word & ~(0xFF << (8 * half))) | (value << (8 * half));
+        }
+        ShadowWriteMem(word_addr, word);
+    }
+    PutPacket("OK");
+}
+
+static void SendRegs(void) {
+    LoadRegs();
+    char *out = gdb.reply;
+    for (int reg = 0; reg < CPU_REGS; reg++) {
+        for (int byte = 0; byte < GDB_REG_BYTES; byte++) {
+            out = PutHexByte(out, byte < 2 ? gdb.regs[reg] >> (8 * byte) : 0);
+        }
+    }
+    *out = '\0';
+    PutPacket(gdb.reply);
+}
+
+// G data, one little endian register after the other
+static void ReceiveRegs(const char *p) {
+    if (strlen(p) < 2 * CPU_REGS * GDB_REG_BYTES) {
+        PutPacket("E01");
+        return;
+    }
+    LoadRegs();
+    for (int reg = 0; reg < CPU_REGS; reg++) {
+        const char *value = &p[2 * GDB_REG_BYTES * reg];
+        SetReg(reg, ParseHexByte(value) | (ParseHexByte(value + 2) << 8));
+    }
+    PutPacket("OK");
+}
+
+// p reg
+static void SendReg(const char *p) {
+    uint32_t reg = ParseHex(&p);
+    if (reg >= CPU_REGS) {
+        PutPacket("E01");
+        return;
+    }
+    LoadRegs();
+    char *out = gdb.reply;
+    for (int byte = 0; byte < GDB_REG_BYTES; byte++) {
+        out = PutHexByte(out, byte < 2 ? gdb.regs[reg] >> (8 * byte) : 0);
+    }
+    *out = '\0';
+    PutPacket(gdb.reply);
+}
+
+// P reg=value
+static void ReceiveReg(const char *p) {
+    uint32_t reg = ParseHex(&p);
+    if (reg >= CPU_REGS || *p++ != '=' || strlen(p) < 4) {
+        PutPacket("E01");
+        return;
+    }
+    LoadRegs();
+    SetReg(reg, ParseHexByte(p) | (ParseHexByte(p + 2) << 8));
+    PutPacket("OK");
+}
+
+// c [addr] or s [addr]
+static void Resume(const char *p, bool step) {
+    LoadRegs();
+    if (*p != '\0') SetReg(0, ParseHex(&p));
+    WriteBack();
+    uint16_t pc = gdb.regs[0];
+    if (step) {
+        WriteCpuReg(0, pc);
+        StepCPU();
+        Ran();
+        PutPacket("S05");
+        return;
+    }
+
+    ReleaseDeviceAt(pc);
+    Ran();
+    while (true) {
+        int c = GetByte(GDB_POLL_MS);
+        if (c == -2) return;
+        if (c == 0x03) break;
+    }
+    GetDevice();
+    SetInstrFetch();
+    HaltCPU();
+    PutPacket("S02");
+}
+
+/*
+    Handles one packet.
+
+    Returns: false once the session is over.
+*/
+static bool Handle(void) {
+    const char *p = gdb.packet;
+    switch (*p++) {
+    case '?':
+        PutPacket("S05");
+        return true;
+    case 'g':
+        SendRegs();
+        return true;
+    case 'G':
+        ReceiveRegs(p);
+        return true;
+    case 'p':
+        SendReg(p);
+        return true;
+    case 'P':
+        ReceiveReg(p);
+        return true;
+    case 'm':
+        ReadMemory(p);
+        return true;
+    case 'M':
+        WriteMemory(p);
+        return true;
+    case 'c':
+        Resume(p, false);
+        return true;
+    case 's':
+        Resume(p, true);
+        return true;
+    case 'H':
+        PutPacket("OK");
+        return true;
+    case 'q':
+        if (strncmp(p, "Supported", 9) == 0) {
+            snprintf(gdb.reply, sizeof(gdb.reply), "PacketSize=%x", GDB_PACKET_SIZE);
+            PutPacket(gdb.reply);
+        } else if (strcmp(p, "Attached") == 0) {
+            PutPacket("1");
+        } else {
+            PutPacket("");
+        }
+        return true;
+    case 'D':
+        WriteBack();
+        PutPacket("OK");
+        ReleaseDeviceAt(gdb.regs[0]);
+        return false;
+    case 'k':
+        ReleaseDevice();
+        return false;
+    default:
+        PutPacket("");
+        return true;
+    }
+}
+
+void GdbServe(const link_t *link) {
+    memset(&gdb, 0, sizeof(gdb));
+    gdb.link = link;
+    // the target may have changed since the shadow was filled
+    ShadowReset();
+    while (GetPacket() >= 0 && Handle()) {
+    }
+    if (gdb.closed) printf("GDB: link closed\n");
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "jtag_link.h"
+
+/*
+    GDB remote serial protocol server for the halted
+    target. The packets map onto the JTAG primitives:
+
+        g G p P   ReadCpuRegs and WriteCpuRegs, with the
+                  registers cached from one stop to the next
+        m M       the shadow, so uncached pages come in as
+                  quick blocks and writes, flash included,
+                  go back to the target when the CPU resumes
+        c         ReleaseDeviceAt, until GDB interrupts
+        s         StepCPU
+
+    Peripherals below SHADOW_START are read and written a
+    word at a time, never cached. There are no breakpoints:
+    a continue runs until GDB sends an interrupt (Ctrl-C).
+*/
+
+#define GDB_PACKET_SIZE 1024 // longest packet, GDB splits bigger transfers
+#define GDB_REG_BYTES 2      // 4 for a GDB built for MSP430X, such as msp430-elf-gdb
+#define GDB_POLL_MS 50       // interrupt poll period while the CPU runs
+
+#define GDB_UART_NUM 1 // a UART of its own, the console would garble packets
+#define GDB_UART_BAUD 115200
+#define GDB_UART_TX 32
+#define GDB_UART_RX 33
+
+/*
+    Serves one session on link until GDB detaches, kills
+    the target or the link closes. The CPU must be under
+    JTAG control and halted. A detach leaves the CPU
+    running from its PC; a kill resets and releases it.
+*/
+void GdbServe(const link_t *link);
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "jtag_image.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_partition.h"
+#endif
+
+typedef struct {
+    const char *text;
+    size_t size;
+    size_t pos;
+    int line;
+    image_sink_t sink;
+    void *ctx;
+    uint32_t run_addr;  // word address of run[0]
+    int run_bytes;
+    uint16_t run[IMAGE_RUN_WORDS];
+    uint8_t record[255]; // data of the Intel HEX record being checked
+} parser_t;
+
+// next character, or -1 at the end of the text
+static int Peek(const parser_t *p) {
+    if (p->pos >= p->size) return -1;
+    uint8_t c = p->text[p->pos];
+    if (c == '\0' || c == 0xFF) return -1;
+    return c;
+}
+
+static int SkipSpace(parser_t *p) {
+    int c;
+    while ((c = Peek(p)) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        if (c == '\n') p->line++;
+        p->pos++;
+    }
+    return c;
+}
+
+static int HexDigit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/*
+    Reads up to max hex digits.
+
+    Returns: number of digits read.
+*/
+static int ReadHex(parser_t *p, int max, uint32_t *value) {
+    int count = 0;
+    *value = 0;
+    while (count < max && HexDigit(Peek(p)) >= 0) {
+        *value = (*value << 4) | HexDigit(Peek(p));
+        p->pos++;
+        count++;
+    }
+    return count;
+}
+
+static bool ReadByte(parser_t *p, uint8_t *byte) {
+    uint32_t value;
+    if (ReadHex(p, 2, &value) != 2) return false;
+    *byte = value;
+    return true;
+}
+
+static bool Emit(parser_t *p) {
+    if (p->run_bytes == 0) return true;
+    if (p->run_bytes & 1) p->run[p->run_bytes / 2] |= 0xFF00;
+    int words = (p->run_bytes + 1) / 2;
+    p->run_bytes = 0;
+    return p->sink(p->run_addr, p->run, words, p->ctx);
+}
+
+static bool PutByte(parser_t *p, uint32_t addr, uint8_t byte) {
+    if (p->run_bytes > 0 && addr != p->run_addr + p->run_bytes) {
+        if (!Emit(p)) return false;
+    }
+    if (p->run_bytes == 0) {
+        p->run_addr = addr & ~1;
+        p->run[0] = 0xFFFF;
+        p->run_bytes = addr & 1;
+    }
+    // MSP430 words are little endian
+    if (p->run_bytes & 1) {
+        p->run[p->run_bytes / 2] = (p->run[p->run_bytes / 2] & 0x00FF) | (byte << 8);
+    } else {
+        p->run[p->run_bytes / 2] = byte;
+    }
+    p->run_bytes++;
+    // a run ends with its segment, so it never spans two
+    if ((p->run_addr + p->run_bytes) % (2 * IMAGE_RUN_WORDS) == 0) return Emit(p);
+    return true;
+}
+
+/*
+    @ADDR lines set the address, followed by lines of hex
+    byte pairs; q ends the file.
+*/
+static bool ParseTiTxt(parser_t *p) {
+    uint32_t addr = 0;
+    bool addressed = false;
+    int c;
+    while ((c = SkipSpace(p)) != -1 && c != 'q') {
+        if (c == '@') {
+            p->pos++;
+            if (ReadHex(p, 8, &addr) == 0) return false;
+            addressed = true;
+            continue;
+        }
+        uint8_t byte;
+        if (!addressed || !ReadByte(p, &byte)) return false;
+        if (HexDigit(Peek(p)) >= 0) return false;
+        if (!PutByte(p, addr++, byte)) return false;
+    }
+    return true;
+}
+
+/*
+    :LLAAAATT followed by LL data bytes and a checksum.
+    Data is only passed on once the checksum is good.
+*/
+static bool ParseIntelHex(parser_t *p) {
+    uint32_t base = 0;
+    int c;
+    while ((c = SkipSpace(p)) != -1) {
+        if (c != ':') return false;
+        p->pos++;
+        uint8_t length, addr_high, addr_low, type, checksum;
+        if (!ReadByte(p, &length) || !ReadByte(p, &addr_high) || !ReadByte(p, &addr_low) ||
+            !ReadByte(p, &type)) {
+            return false;
+        }
+        uint8_t sum = length + addr_high + addr_low + type;
+        for (int i = 0; i < length; i++) {
+            if (!ReadByte(p, &p->record[i])) return false;
+            sum += p->record[i];
+        }
+        if (!ReadByte(p, &checksum) || (uint8_t) (sum + checksum) != 0) return false;
+
+        uint32_t offset = (addr_high << 8) | addr_low;
+        uint32_t value = length == 2 ? (p->record[0] << 8) | p->record[1] : 0;
+        switch (type) {
+        case 0x00: // data
+            for (int i = 0; i < length; i++) {
+                if (!PutByte(p, base + ((offset + i) & 0xFFFF), p->record[i])) return false;
+            }
+            break;
+        case 0x01: // end of file
+            return true;
+        case 0x02: // extended segment address
+            if (length != 2) return false;
+            base = value << 4;
+            break;
+        case 0x04: // extended linear address
+            if (length != 2) return false;
+            base = value << 16;
+            break;
+        case 0x03: // start addresses
+        case 0x05:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ImageParse(const char *text, size_t size, image_sink_t sink, void *ctx) {
+    parser_t p = {
+        .text = text,
+        .size = size,
+        .line = 1,
+        .sink = sink,
+        .ctx = ctx,
+    };
+    int c = SkipSpace(&p);
+    bool ok;
+    if (c == '@') {
+        ok = ParseTiTxt(&p);
+    } else if (c == ':') {
+        ok = ParseIntelHex(&p);
+    } else {
+        printf("Image: unknown format\n");
+        return false;
+    }
+    ok = ok && Emit(&p);
+    if (!ok) printf("Image: stopped on line %d\n", p.line);
+    return ok;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+bool ImageLoadPartition(const char *label, image_sink_t sink, void *ctx) {
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        printf("Image: no partition \"%s\"\n", label);
+        return false;
+    }
+    const void *text;
+    esp_partition_mmap_handle_t handle;
+    if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &text,
+                           &handle) != ESP_OK) {
+        printf("Image: cannot map partition \"%s\"\n", label);
+        return false;
+    }
+    bool ok = ImageParse(text, partition->size, sink, ctx);
+    esp_partition_munmap(handle);
+    return ok;
+}
+#endif
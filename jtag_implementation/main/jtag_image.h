@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Streaming loader for firmware images in TI-TXT or Intel
+    HEX format. The text is parsed in place in one pass,
+    and consecutive bytes are gathered into runs of up to
+    IMAGE_RUN_WORDS words, merged across records and lines,
+    which are handed to a sink as they fill up. Memory use
+    is one run and one record whatever the image size.
+
+    Runs start on a word address and end at the latest on
+    a multiple of IMAGE_RUN_WORDS words, so each one lies
+    within a single main flash segment. A byte missing at
+    either end of a run is filled with 0xFF, the erased
+    flash value.
+*/
+
+#define IMAGE_RUN_WORDS 256 // one main flash segment, FLASH_MAIN_SEGMENT bytes
+
+/*
+    Receives length words starting at addr.
+
+    Returns: false to stop the parse.
+*/
+typedef bool (*image_sink_t)(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx);
+
+/*
+    Parses an image of up to size bytes, stopping early at
+    the end marker ('q' or an end of file record), a NUL or
+    an erased 0xFF byte. The format is taken from the first
+    character: '@' for TI-TXT, ':' for Intel HEX.
+
+    Returns: false on a malformed record or if the sink
+    failed.
+*/
+bool ImageParse(const char *text, size_t size, image_sink_t sink, void *ctx);
+
+/*
+    Maps the data partition labelled label and parses the
+    image stored in it, without copying it to RAM. Not
+    available on the linux target.
+
+    Returns: false if the partition is missing or the parse
+    failed.
+*/
+bool ImageLoadPartition(const char *label, image_sink_t sink, void *ctx);
@@ -1,363 +1,151 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/gpio.h"
-
-#define HIGH 1
-#define LOW 0
-#define INPUT GPIO_MODE_INPUT
-#define OUTPUT GPIO_MODE_OUTPUT
-
-// JTAG pins are from the perspective of the MSP430
-#define RST GPIO_NUM_16 // MSP430 reset                     (RX)  ->  (16) 
-#define TMS GPIO_NUM_17 // JTAG state machine control       (TX)  ->  (7)
-#define TCK GPIO_NUM_18 // JTAG clock input                 (MO)  ->  (6)
-#define TDI GPIO_NUM_19 // JTAG data input and TCLK input   (MI)  ->  (14)
-#define TDO GPIO_NUM_21 // JTAG data output                 (21)  ->  (15)
-#define TEN GPIO_NUM_22 // JTAG enable                      (SCL) ->  (17)
+#include "esp_attr.h"
+#include "jtag_io.h"
+#include "jtag.h"
+#include "jtag_bench.h"
+#include "jtag_cmd.h"
+#include "jtag_dump.h"
+#include "jtag_engine.h"
+#include "jtag_exec.h"
+#include "jtag_flash.h"
+#include "jtag_gang.h"
+#include "jtag_gdb.h"
+#include "jtag_image.h"
+#include "jtag_link.h"
+#include "jtag_shadow.h"
+#include "jtag_sync.h"
+#include "jtag_trace.h"
+#include "jtag_wave.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <stdlib.h>
+#include <time.h>
+#include "jtag_check.h"
+#include "jtag_sim.h"
+#else
+#include "driver/uart.h"
+#endif
 
 #define LOCATION 0x00
+#define SPI_TCK_HZ 4000000 // TCK during SPI shifts, MSP430 allows up to 10 MHz
+#define WAVE_TCK_HZ 2000000 // TCK during DMA waveforms
+#define ROW_WORDS 16
+#define LOAD_IMAGE 0  // program the image stored in the "image" partition
+#define DUMP_BINARY 0 // dump memory as binary frames instead of text, see jtag_dump.h
+#define RUN_BENCH 0   // benchmark every shift engine on the halted device, see jtag_bench.h
+#define SPY_BI_WIRE 0 // 2-wire JTAG on TEST and RST, for boards without the 4-wire pins
+#define GANG 0        // targets on shared TMS, TCK and TDI with a TDO pin each, see jtag_gang.h
+#define GANG_TDO_PINS {TDO, 23, 13, 14} // below GPIO 32, clear of the waveform pins 25-27
+#define PIPELINE 0    // JTAG on a task of its own on the other core, see jtag_exec.h
+#define GDB_SERVER 0  // serve one GDB session (a pty on linux) once the CPU is halted, see jtag_gdb.h
+#define CMD_SERVER 0  // serve tools/jtag_cli.c on the console UART (a pty on linux), see jtag_cmd.h
 
-const uint8_t IR_ADDR_16BIT = 0x83;
-const uint8_t IR_ADDR_CAPTURE = 0x84;
-const uint8_t IR_DATA_TO_ADDR = 0x85;
-const uint8_t IR_DATA_16BIT = 0x41;
-const uint8_t IR_DATA_QUICK = 0x43;
-const uint8_t IR_BYPASS = 0xFF;
-const uint8_t IR_CNTRL_SIG_16BIT = 0x13;
-const uint8_t IR_CNTRL_SIG_CAPTURE = 0x14;
-const uint8_t IR_CNTRL_SIG_RELEASE = 0x15;
-const uint8_t IR_DATA_PSA = 0x44;
-const uint8_t IR_SHIFT_OUT_PSA = 0x46;
-const uint8_t IR_Prepare_Blow = 0x22;
-const uint8_t IR_Ex_Blow = 0x24;
-const uint8_t IR_JMB_EXCHANGE = 0x61;
-
-/*
-    Shifts an 8-bit JTAG instruction into the JTAG
-    instruction register via the TDI. At the same time,
-    the 8-bit JTAG ID is shifted out via the TDO. Each
-    instruction bit is captured from TDI on the rising
-    edge of the TCK. Shifted LSB first.
-
-    Returns: 8-bit JTAG ID
-*/
-uint8_t IR_SHIFT(uint8_t input_data) {
-    uint16_t ret = 0x00;
-    int prevTDI = gpio_get_level(TDI);
-
-    // set TAP machine to Shift-IR state
-    // TMS set through falling and rising edge
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Select DR)
-
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Select IR)
-
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (Capture IR)
-
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (Shift IR)
-
-    // shift data into IR
-    uint8_t bit;
-    for (int i = 0; i < 7; i++) {
-        bit = input_data >> i;
-        bit &= 0x01; // send the selected bit
-        gpio_set_level(TDI, (uint32_t) bit);
-        gpio_set_level(TCK, LOW);
-        gpio_set_level(TCK, HIGH);
-        uint16_t output = gpio_get_level(TDO);
-        ret |= output << (7 - i);
-    }
-
-    // Send MSB and return to Run/Idle
-    bit = input_data >> 7;
-    bit &= 0x01;
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TDI, bit);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Exit IR)
-    ret |= gpio_get_level(TDO);
-
-    gpio_set_level(TDI, prevTDI);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Update IR)
-
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (IDLE)
-
-    for (int i = 0; i < 4; i++) {
-        gpio_set_level(TCK, LOW);
-        gpio_set_level(TCK, HIGH);
-    }
-
-    return ret;
+void RWTest() {
+    // write data
+    uint16_t addr1 = 0xFFF0; // part of RAM (I think)
+    uint16_t addr2 = 0xFF88;
+    uint16_t addr3 = 0x0332;
+    uint16_t addr4 = 0x0200;
+    // WriteMem(addr1, 0xDEAD);
+    // WriteMem(addr2, 0xBEEF);
+    WriteMem(addr3, 0xB0BA);
+    WriteMem(addr4, 0xCAFE);
+    ReadMem(addr1);
+    ReadMem(addr2);
+    ReadMem(addr3);
+    ReadMem(addr4);
 }
 
-/*
-    Shifts a 16-bit word into the JTAG data register (DR).
-    The word is shifted, MSB first, via the TDI. At the
-    same time, the last captured and stored value in the
-    addressed data register is shifted out via the TDO. A
-    new bit is present at TDO with a falling edge of TCK.
-    Shifted MSB first.
-
-    Returns: Last captured and stored value in the
-    addressed data register.
-*/
-uint16_t DR_SHIFT(uint16_t input_data) {
-    uint16_t ret = 0x0000;
-    int prevTDI = gpio_get_level(TDI);
-
-    // set TAP machine to Shift-DR state
-    // TMS set through falling and rising edge
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Select DR)
-
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (Capture DR)
-
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (Shift DR)
-
-    // shift data into DR
-    uint16_t bit;
-    for (int i = 15; i > 0; i--) {
-        bit = input_data >> i;
-        bit &= 0x0001; // send the selected bit
-        gpio_set_level(TDI, (uint32_t) bit);
-        gpio_set_level(TCK, LOW);
-        gpio_set_level(TCK, HIGH);
-        uint16_t output = gpio_get_level(TDO);
-        ret |= output << i;
-    }
-    // Send LSB and return to Run/Idle
-    bit = input_data;
-    bit &= 0x0001;
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TDI, bit);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Exit DR)
-    ret |= gpio_get_level(TDO);
-
-    gpio_set_level(TDI, prevTDI);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 1 (Update DR)
-
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH); // 0 (IDLE)
-
-    for (int i = 0; i < 4; i++) {
-        gpio_set_level(TCK, LOW);
-        gpio_set_level(TCK, HIGH);
-    }
-
-    return ret;
-}
+static DMA_ATTR uint8_t wave_samples[WAVE_MAX_SAMPLES];
+static DMA_ATTR uint8_t wave_tdo[WAVE_MAX_SAMPLES / 16];
+static wave_capture_t wave_captures[ROW_WORDS];
+static bool wave_ready = false;
 
 /*
-    Sets TCLK to LOW, which acts as the falling edge of
-    the CPU clock. Executed in the Run/Idle state. Note
-    that the MSP430 is not pipelined, so a full TCLK cycle
-    executes the CPU instruction located at the PC.
-*/
-void ClrTCLK() {
-    gpio_set_level(TDI, LOW);
-}
+    Reads count consecutive words from addr with
+    ReadMemQuick, recorded as one waveform and played out
+    by DMA.
 
-/*
-    Sets TCLK to HIGH, which acts as the rising edge of
-    the CPU clock. Executed in the Run/Idle state. Note
-    that the MSP430 is not pipelined, so a full TCLK cycle
-    executes the CPU instruction located at the PC.
+    Returns: false if the waveform engine is unavailable,
+    as it always is with GANG set.
 */
-void SetTCLK() {
-    gpio_set_level(TDI, HIGH);
+static bool ReadRowWave(uint32_t addr, uint16_t *words, int count) {
+    if (!wave_ready) return false;
+    wave_seq_t seq;
+    WaveBegin(&seq, wave_samples, sizeof(wave_samples), wave_captures, ROW_WORDS);
+    ReadMemQuick(addr, count, words);
+    WaveEnd(&seq);
+    return WaveRun(&seq, wave_tdo);
 }
 
 /*
-    Takes the CPU under JTAG Control.
+    Dumps memory from start_addr up to stop_addr, one row
+    of 16 words at a time, with quick memory access. Ranges
+    reaching past 64 KB are read with 20-bit addresses,
+    which requires an MSP430X device.
 */
-void GetDevice() {
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2401);
-    IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
-    printf("Syncing CPU...\n");
-    while (true) {
-        uint16_t TDOword = DR_SHIFT((uint16_t) 0x0000);
-        if ((TDOword & 0x0200) != 0) {
-            printf("Sync Successful!\n");
-            return;
+void ReadCode(uint32_t start_addr, uint32_t stop_addr) {
+    bool cpux = stop_addr > 0x10000;
+    uint16_t row[ROW_WORDS];
+    for (uint32_t row_addr = start_addr; row_addr < stop_addr; row_addr += 2 * ROW_WORDS) {
+        int count = (stop_addr - row_addr + 1) / 2;
+        if (count > ROW_WORDS) count = ROW_WORDS;
+        if (cpux) {
+            ReadMemQuick_430X(row_addr, count, row);
+        } else if (!ReadRowWave(row_addr, row, count)) {
+            ReadMemQuick(row_addr, count, row);
+        }
+        printf("\nAddress 0x%.5lx: ", (unsigned long) row_addr);
+        for (int i = 0; i < count; i++) {
+            printf("0x%.4x ", row[i]);
         }
-    }   
-}
-
-/*
-    Releases CPU from JTAG control. The target CPU
-    starts program execution with the address stored
-    at location 0x0FFFE (reset vector).
-    
-    This function is very distinct from ReleaseCPU!
-*/
-void ReleaseDevice() {
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2C01); // apply reset
-    DR_SHIFT((uint16_t) 0x2401); // remove reset
-    IR_SHIFT(IR_CNTRL_SIG_RELEASE);
-}
-
-/*
-    Sets the CPU to instruction-fetch state. This is used
-    to execute an instruction presented by a host over the
-    JTAG port.
-*/
-void SetInstrFetch() {
-    IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
-    uint16_t data = DR_SHIFT((uint16_t) 0x0000);
-    for (int i = 0; i < 8; i++) {
-        printf("InstrFetch: 0x%X\n", data);
-        if ((data & 0x0080) != 0) return;
-        ClrTCLK();
-        SetTCLK();
     }
-    printf("SetInstrFetch Unsuccessful!\n");
-}
-
-/*
-    Loads the target device CPU's program counter 
-    with the desired 16-bit address.
-*/
-void SetPC(uint16_t addr) {
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x3401);
-    IR_SHIFT(IR_DATA_16BIT);
-    DR_SHIFT((uint16_t) 0x4030);
-    ClrTCLK();
-    SetTCLK();
-    DR_SHIFT(addr);
-    ClrTCLK();
-    SetTCLK();
-    IR_SHIFT(IR_ADDR_CAPTURE);
-    ClrTCLK();
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2401);
-}
-
-/*
-    Force a power-up reset of CPU
-*/
-void ExecutePOR() {
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2c01);
-    DR_SHIFT((uint16_t) 0x2401);
-    ClrTCLK();
-    SetTCLK();
-    ClrTCLK();
-    SetTCLK();
-    ClrTCLK();
-    IR_SHIFT(IR_ADDR_CAPTURE);
-    SetTCLK();
-}
-
-/*
-    Stopping of the CPU via the HALT_JTAG bit of the JTAG
-    control signal register, which is set to 1 here.
-*/
-void HaltCPU() {
-    // Execute JMP $ instr to maintain state
-    IR_SHIFT(IR_DATA_16BIT);
-    DR_SHIFT((uint16_t) 0x3FFF);
-    ClrTCLK();
-    // set halt bit in cntrl signal
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2409);
-    SetTCLK();
+    printf("\n");
 }
 
+#if (LOAD_IMAGE && !GANG && !PIPELINE) || CONFIG_IDF_TARGET_LINUX
 /*
-    Starting of the CPU via the HALT_JTAG bit of the JTAG
-    control signal register, which is set to 0 here.
+    Image sink that brings the flash in line with each run,
+    rewriting only the segments that differ.
 */
-void ReleaseCPU() {
-    ClrTCLK();
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2401);
-    IR_SHIFT(IR_ADDR_CAPTURE);
-    SetTCLK();
+static bool ProgramRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx) {
+    if (addr < FLASH_INFO_START || addr + 2 * length > 0x10000) {
+        printf("Image: run at 0x%.5lx is outside flash\n", (unsigned long) addr);
+        return false;
+    }
+    return ShadowProgram(addr, length, words);
 }
+#endif
 
+#if GANG && LOAD_IMAGE && !CONFIG_IDF_TARGET_LINUX
 /*
-    Reads one word (2 bytes) of memory at addr.
+    Image sink for a gang. The shadow covers one target
+    only, so each run is programmed whole.
 */
-uint16_t ReadMem(uint16_t addr) {
-    ClrTCLK();
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2409); // one word, not byte
-    IR_SHIFT(IR_ADDR_16BIT);
-    DR_SHIFT(addr);
-    IR_SHIFT(IR_DATA_TO_ADDR);
-    SetTCLK();
-    ClrTCLK();
-    uint16_t data = DR_SHIFT((uint16_t) 0x0000);
-    return data;
-}
-
-void WriteMem(uint16_t addr, uint16_t data) {
-    ClrTCLK();
-    IR_SHIFT(IR_CNTRL_SIG_16BIT);
-    DR_SHIFT((uint16_t) 0x2408);
-    // printf("\tcontrol check: \n");
-    // IR_SHIFT(IR_CNTRL_SIG_CAPTURE);
-    // printf("\tcontrol signal is: 0x%.4x\n", DR_SHIFT(0x1111));
-    IR_SHIFT(IR_ADDR_16BIT);
-    DR_SHIFT(addr);
-    // printf("\taddress check: \n");
-    // IR_SHIFT(IR_ADDR_CAPTURE);
-    // printf("\tAddress is: 0x%.4x\n", DR_SHIFT(0x4444));
-    IR_SHIFT(IR_DATA_TO_ADDR);
-    DR_SHIFT(data);
-    SetTCLK();
-}
-
-void RWTest() {
-    // write data
-    uint16_t addr1 = 0xFFF0; // part of RAM (I think)
-    uint16_t addr2 = 0xFF88;
-    uint16_t addr3 = 0x0332;
-    uint16_t addr4 = 0x0200;
-    // WriteMem(addr1, 0xDEAD);
-    // WriteMem(addr2, 0xBEEF);
-    WriteMem(addr3, 0xB0BA);
-    WriteMem(addr4, 0xCAFE);
-    ReadMem(addr1);
-    ReadMem(addr2);
-    ReadMem(addr3);
-    ReadMem(addr4);
+static bool GangRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx) {
+    if (addr < FLASH_INFO_START || addr + 2 * length > 0x10000) {
+        printf("Image: run at 0x%.5lx is outside flash\n", (unsigned long) addr);
+        return false;
+    }
+    return GangProgram(addr, length, words) != 0;
 }
+#endif
 
-void ReadCode(uint16_t start_addr, uint16_t stop_addr) {
-    for (uint16_t curr_addr = start_addr; curr_addr < stop_addr; curr_addr+=4) {
-        if (curr_addr % 64 == 0) {
-            printf("\nAddress 0x%.4x: ", curr_addr);
-        }
-        printf("0x%.4x ", ReadMem(curr_addr));
-    }
-    printf("\n");
+#if DUMP_BINARY && !CONFIG_IDF_TARGET_LINUX
+// straight to the UART driver, since stdout would turn \n into \r\n
+static void WriteDump(const uint8_t *data, int length) {
+    uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, data, length);
 }
+#endif
 
 void RegisterTest() {
     uint8_t output;
     for (uint8_t i = 0; i < 10; i++) {
         output = IR_SHIFT(i);
-        if (output != (uint8_t) 0x89) {
+        if (output != (uint8_t) JTAG_ID) {
             printf("IR_SHIFT failed to return JTAG ID!\n");
             return;
         }
@@ -410,6 +198,252 @@ void RegisterTest() {
     return;
 }
 
+#if CONFIG_IDF_TARGET_LINUX
+static double Seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define PROFILE(name, runs, call) do {                              \
+        SimClearStats();                                            \
+        double start = Seconds();                                   \
+        for (int run = 0; run < (runs); run++) {                    \
+            call;                                                   \
+        }                                                           \
+        double elapsed = Seconds() - start;                         \
+        const sim_stats_t *stats = SimStats();                      \
+        printf("%-10s %6.1f writes/op %6.1f toggles/op %6.1f TCK/op %9.0f ops/s\n", \
+               name, (double) stats->pin_writes / (runs),           \
+               (double) stats->toggles / (runs),                    \
+               (double) stats->tck_cycles / (runs), (runs) / elapsed); \
+    } while (0)
+
+/*
+    Programs QUICK_WORDS words of flash against the
+    simulated target and reports pin writes (GPIO calls or
+    register stores), pin toggles and TCK cycles per call,
+    along with calls per second. The primitives themselves
+    are covered by RunBenchmarks.
+*/
+#define QUICK_WORDS 64
+
+static void ProfileFlash() {
+    uint16_t block[QUICK_WORDS];
+    for (int i = 0; i < QUICK_WORDS; i++) {
+        block[i] = i;
+    }
+    PROFILE("ProgramFLASH", 10, ProgramFLASH((uint16_t) 0xC000, QUICK_WORDS, block));
+}
+
+/*
+    Saves the 16 registers one ReadCpuReg at a time and
+    with one batched ReadCpuRegs, then restores them.
+*/
+static void ProfileRegs() {
+    uint16_t regs[CPU_REGS];
+    SetInstrFetch();
+    HaltCPU();
+    PROFILE("RegsSingle", 10, for (int reg = 0; reg < CPU_REGS; reg++) regs[reg] = ReadCpuReg(reg));
+    PROFILE("RegsSave", 10, ReadCpuRegs(regs));
+    PROFILE("RegsLoad", 10, WriteCpuRegs(regs, 0xFFFF));
+}
+
+/*
+    Reflashes a 4 KB image after changing one word, with
+    the shadow cold (as after a reset) and warm.
+*/
+static void ProfileShadow() {
+    static uint16_t image[2048];
+    for (int i = 0; i < 2048; i++) {
+        image[i] = i * 7;
+    }
+    ShadowReset();
+    PROFILE("Flash4K", 1, ShadowProgram((uint16_t) 0xC000, 2048, image));
+    image[1000] ^= 0x0101;
+    ShadowReset();
+    PROFILE("DiffCold", 1, ShadowProgram((uint16_t) 0xC000, 2048, image));
+    image[1000] ^= 0x0101;
+    PROFILE("DiffWarm", 1, ShadowProgram((uint16_t) 0xC000, 2048, image));
+}
+
+static const char image_txt[] =
+    "@C000\n"
+    "31 40 00 04 B2 40 80 5A 20 01 D2 D3 22 00 D2 E3\n"
+    "21 00 3F 40 50 C3 1F 83 FE 23 F9 3F\n"
+    "@FFFE\n"
+    "00 C0\n"
+    "q\n";
+
+static const char image_hex[] =
+    ":10C0000031400004B240805A2001D2D32200D2E352\n"
+    ":0CC0100021003F4050C31F83FE23F93F76\n"
+    ":02FFFE0000C041\n"
+    ":00000001FF\n";
+
+static bool VerifyRun(uint32_t addr, const uint16_t *words, uint16_t length, void *ctx) {
+    return VerifyPSA(addr, length, words);
+}
+
+/*
+    Programs the same small image from TI-TXT and checks
+    it from Intel HEX.
+*/
+static void ProfileImage() {
+    SimClearStats();
+    bool ok = ImageParse(image_txt, sizeof(image_txt), ProgramRun, NULL) &&
+              ImageParse(image_hex, sizeof(image_hex), VerifyRun, NULL);
+    printf("Image      %s, %llu TCK\n", ok ? "programmed and verified" : "FAILED",
+           (unsigned long long) SimStats()->tck_cycles);
+}
+
+static FILE *dump_file;
+static long dump_bytes;
+
+static void WriteDumpFile(const uint8_t *data, int length) {
+    fwrite(data, 1, length, dump_file);
+    dump_bytes += length;
+}
+
+/*
+    Dumps all 64 KB to dump.bin, for tools/dump_decode,
+    and reports the stream size.
+*/
+static void ProfileDump() {
+    dump_file = fopen("dump.bin", "wb");
+    if (dump_file == NULL) return;
+    dump_bytes = 0;
+    PROFILE("Dump64K", 1, DumpMemory(0x0000, 0x10000, WriteDumpFile));
+    fclose(dump_file);
+    printf("Dump64K    %ld bytes in dump.bin\n", dump_bytes);
+}
+
+/*
+    Programs the image over a corrupted copy and dumps
+    memory again, this time through the executor task.
+*/
+static void ProfilePipeline() {
+    if (!ExecStart()) return;
+    SimPoke(0xC000, 0x0000);
+    ShadowReset();
+    SimClearStats();
+    bool ok = ImageParse(image_txt, sizeof(image_txt), ExecProgramRun, NULL);
+    ok = ExecFinish() && ok && ImageParse(image_hex, sizeof(image_hex), VerifyRun, NULL);
+    printf("Pipeline   image %s, %llu TCK\n", ok ? "programmed and verified" : "FAILED",
+           (unsigned long long) SimStats()->tck_cycles);
+    ProfileDump();
+    ExecStop();
+}
+
+/*
+    Calibrates against a simulated link that carries at
+    most 3 MHz, once per engine.
+*/
+static void ProfileCalibration() {
+    const jtag_engine_t *engines[] = {&gpio_driver_engine, &gpio_fast_engine, &spi_engine};
+    SimSetLinkLimit(3000000);
+    for (int i = 0; i < 3; i++) {
+        SetShiftEngine(engines[i]);
+        printf("Calibrate  %-12s %8lu Hz\n", engines[i]->name, (unsigned long) CalibrateTck());
+    }
+    SimSetLinkLimit(0);
+}
+
+/*
+    Programs a gang of three simulated targets, one with
+    other code in flash, through four TDO lanes, the last
+    of which has no target on it.
+*/
+static void ProfileGang() {
+    const int sim_pins[] = {TDO, 23, 25};
+    const int lanes[] = {TDO, 23, 25, 26};
+    uint16_t block[QUICK_WORDS];
+    for (int i = 0; i < QUICK_WORDS; i++) {
+        block[i] = i;
+    }
+    SimSetGang(3, sim_pins);
+    SimSelect(1);
+    for (int i = 0; i < QUICK_WORDS; i++) {
+        SimPoke(0xC000 + 2 * i, 0x3FFF);
+    }
+    SimSelect(0);
+
+    const jtag_engine_t *current = GetShiftEngine();
+    GangInit(lanes, 4);
+    uint32_t ready = GangConnect();
+    uint32_t verified = GangProgram(0xC000, QUICK_WORDS, block);
+    printf("Gang       connected 0x%lx, verified 0x%lx\n", (unsigned long) ready,
+           (unsigned long) verified);
+    GangReport();
+    PROFILE("GangProgram", 10, GangProgram(0xC000, QUICK_WORDS, block));
+
+    SimSetGang(1, sim_pins);
+    SetShiftEngine(current);
+}
+
+/*
+    Connects to a target that syncs at once, then to one
+    that only comes back after a POR, after a new JTAG
+    entry, or never, then to one that takes a few TCLKs
+    to fetch and one that takes too many, and prints the
+    sync statistics.
+*/
+static void ProfileSync() {
+    static const sim_hang_t hangs[] = {
+        SIM_HANG_NONE, SIM_HANG_UNTIL_POR, SIM_HANG_UNTIL_ENTRY, SIM_HANG_ALWAYS,
+    };
+    SyncClearStats();
+    for (int i = 0; i < 4; i++) {
+        SimSetHang(hangs[i]);
+        printf("Connect    %s\n", ConnectDevice() ? "ok" : "failed");
+    }
+    SimSetHang(SIM_HANG_NONE);
+    SimSetFetchDelay(3);
+    printf("Connect    %s\n", ConnectDevice() ? "ok" : "failed");
+    SimSetFetchDelay(12);
+    printf("Connect    %s\n", ConnectDevice() ? "ok" : "failed");
+    SimSetFetchDelay(0);
+    SyncPrintStats();
+    ConnectDevice();
+}
+
+/*
+    Switches the simulated target to Spy-Bi-Wire and runs
+    the primitives and flash programming over it. Kept
+    last, since the target stays in SBW mode.
+*/
+static void ProfileSbw() {
+    EnterSBW();
+    SetShiftEngine(&sbw_engine);
+    ResetTAP();
+    GetDevice();
+    SetInstrFetch();
+    HaltCPU();
+    printf("Profiling primitives with %s engine...\n", sbw_engine.name);
+    RunBenchmarks();
+    ProfileFlash();
+}
+
+void ProfilePrimitives() {
+    const jtag_engine_t *engines[] = {&gpio_driver_engine, &gpio_fast_engine, &spi_engine};
+    for (int i = 0; i < 3; i++) {
+        SetShiftEngine(engines[i]);
+        printf("Profiling primitives with %s engine...\n", engines[i]->name);
+        RunBenchmarks();
+        ProfileFlash();
+    }
+    ProfileRegs();
+    ProfileShadow();
+    ProfileImage();
+    ProfileDump();
+    ProfilePipeline();
+    ProfileCalibration();
+    ProfileGang();
+    ProfileSync();
+    ProfileSbw();
+}
+#endif
+
 /*
     Drives one JTAG command on the MSP430 via standard
     4-Wire JTAG signals. Specifically, it reads one byte
@@ -419,70 +453,165 @@ void RegisterTest() {
 void app_main(void)
 {
     // configure pins
-    gpio_reset_pin(RST);
-    gpio_reset_pin(TMS);
-    gpio_reset_pin(TCK);
-    gpio_reset_pin(TDI);
-    gpio_reset_pin(TDO);
-    gpio_reset_pin(TEN);
-    gpio_set_direction(RST, OUTPUT);
-    gpio_set_direction(TMS, OUTPUT);
-    gpio_set_direction(TCK, OUTPUT);
-    gpio_set_direction(TDI, OUTPUT);
-    gpio_set_direction(TDO, INPUT);
-    gpio_set_direction(TEN, OUTPUT);
-    gpio_set_pull_mode(TDO, GPIO_PULLDOWN_ONLY);
-
-    // enable JTAG access: case 2a, Fig.2-13
-    // RST held low for JTAG, high for SBW
-    gpio_set_level(RST, HIGH);
-    gpio_set_level(TEN, LOW);
-        // there is a ~28 microsecond delay
-    gpio_set_level(TEN, HIGH);
-    gpio_set_level(RST, LOW);
-    gpio_set_level(TEN, LOW);
-    gpio_set_level(TEN, HIGH);
-    gpio_set_level(RST, HIGH);
-
-    // Move TAP FSM to Run/IDLE for fuse check
-    gpio_set_level(TMS, HIGH);
-    for (int i = 0; i < 6; i++) {
-        gpio_set_level(TCK, LOW);
-        gpio_set_level(TCK, HIGH);  // FSM: TLR
+    PinInit();
+#if SPY_BI_WIRE
+    EnterSBW();
+    SetShiftEngine(&sbw_engine);
+#else
+    if (SpiInit(SPI_TCK_HZ)) {
+        SetShiftEngine(&spi_engine);
+    }
+#if !GANG
+    // the gang reads TDO from every target, which a waveform does not
+    wave_ready = WavePortInit(WAVE_TCK_HZ);
+#endif
+
+    // enable JTAG access
+    EnterJTAG();
+#endif
+
+#if GANG
+    int gang_pins[] = GANG_TDO_PINS;
+    if (GangInit(gang_pins, sizeof(gang_pins) / sizeof(gang_pins[0]))) {
+        printf("Connecting gang...\n");
+        if (GangConnect() == 0) printf("No target in the gang answered\n");
+        GangReport();
     }
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TDI, HIGH);  // FSM: IDLE
-    gpio_set_level(TCK, LOW);
-    gpio_set_level(TCK, HIGH);
-
-    gpio_set_level(TCK, LOW); 
-    gpio_set_level(TCK, HIGH);
-
-    // fuse check
-    gpio_set_level(TMS, HIGH);   
-    gpio_set_level(TMS, LOW);   
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TMS, LOW);
-    gpio_set_level(TMS, HIGH);
-    gpio_set_level(TMS, LOW);
+#else
+    // TAP to Run/IDLE and fuse check
+    ResetTAP();
+#endif
 
     // RegisterTest();
-    GetDevice();
-
-    SetInstrFetch();
+    uint32_t tck_hz = CalibrateTck();
+    if (tck_hz == 0) {
+        printf("JTAG loopback failed at every TCK rate, check the wiring\n");
+    } else {
+        printf("TCK: %lu Hz\n", (unsigned long) tck_hz);
+    }
+#if CMD_SERVER && !GANG
+    // the host connects, halts and programs the target itself
+#if CONFIG_IDF_TARGET_LINUX
+    const link_t *cmd_link = LinkOpenPty();
+#else
+    fflush(stdout);
+    const link_t *cmd_link = LinkOpenUart(CONFIG_ESP_CONSOLE_UART_NUM, 0, UART_PIN_NO_CHANGE,
+                                          UART_PIN_NO_CHANGE, CMD_WINDOW * CMD_FRAME_MAX);
+#endif
+    if (cmd_link != NULL) {
+        CmdServe(cmd_link);
+        LinkClose();
+        return;
+    }
+    printf("Command link not available\n");
+#endif
+#if !GANG
     printf("Halting CPU...\n");
-    HaltCPU();
+    if (!ConnectDevice()) {
+        printf("Target not responding, check the fixture\n");
+        SyncPrintStats();
+        PinSet(TEN, LOW);
+        return;
+    }
+#endif
+
+#if RUN_BENCH && !CONFIG_IDF_TARGET_LINUX
+    const jtag_engine_t *engines[] = {&gpio_driver_engine, &gpio_fast_engine, &spi_engine};
+    const jtag_engine_t *current = GetShiftEngine();
+    for (int i = 0; i < 3; i++) {
+        // the SPI engine is only there if SpiInit succeeded
+        if (engines[i] == &spi_engine && current != &spi_engine) continue;
+        SetShiftEngine(engines[i]);
+        RunBenchmarks();
+    }
+    SetShiftEngine(current);
+#endif
+
+#if GDB_SERVER
+#if CONFIG_IDF_TARGET_LINUX
+    const link_t *gdb_link = LinkOpenPty();
+#else
+    const link_t *gdb_link = LinkOpenUart(GDB_UART_NUM, GDB_UART_BAUD, GDB_UART_TX, GDB_UART_RX,
+                                          2 * GDB_PACKET_SIZE);
+    if (gdb_link == NULL) printf("GDB: UART %d not available\n", GDB_UART_NUM);
+#endif
+    if (gdb_link != NULL) {
+        GdbServe(gdb_link);
+        LinkClose();
+        // the session left the CPU running or reset
+        GetDevice();
+        SetInstrFetch();
+        HaltCPU();
+    }
+#endif
+
+#if PIPELINE
+    if (!ExecStart()) {
+        printf("JTAG executor not started, running commands inline\n");
+    }
+#endif
+
+#if LOAD_IMAGE && !CONFIG_IDF_TARGET_LINUX
+#if GANG
+    if (ImageLoadPartition("image", GangRun, NULL)) {
+        printf("Image programmed\n");
+    }
+    GangReport();
+#elif PIPELINE
+    // the next run is decoded while the executor programs this one
+    bool programmed = ImageLoadPartition("image", ExecProgramRun, NULL);
+    if (ExecFinish() && programmed) {
+        printf("Image programmed\n");
+    }
+#else
+    if (ImageLoadPartition("image", ProgramRun, NULL)) {
+        printf("Image programmed\n");
+    }
+#endif
+#endif
 
     printf("\n");
-    for (uint16_t curr_start = 0xC000; curr_start <= 0xE000; curr_start += (uint16_t) 0x1000) {
+    // the quick reads move the PC; the CPU picks up where it was halted
+    uint16_t context[CPU_REGS];
+    ReadCpuRegs(context);
+#if DUMP_BINARY && !CONFIG_IDF_TARGET_LINUX
+    fflush(stdout);
+    uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0);
+    DumpMemory(0xC000, 0xF000, WriteDump);
+    uart_wait_tx_done(CONFIG_ESP_CONSOLE_UART_NUM, portMAX_DELAY);
+#else
+    for (uint32_t curr_start = 0xC000; curr_start <= 0xE000; curr_start += 0x1000) {
         ReadCode(curr_start, curr_start + 0x1000);
         printf("\n");
     }
+#endif
+    WriteCpuRegs(context, 0xFFFF);
 
     printf("\n");
     ReleaseCPU();
+#if JTAG_TRACE
+    // timing of the session so far, the VCD covers its last TRACE_ENTRIES pin changes
+    TracePrintHistograms();
+#if CONFIG_IDF_TARGET_LINUX
+    FILE *vcd = fopen("trace.vcd", "w");
+    if (vcd != NULL) {
+        TraceExportVcd(vcd);
+        fclose(vcd);
+    }
+#else
+    TraceExportVcd(stdout);
+#endif
+    TraceClear();
+#endif
     // // relinquish JTAG access
     // ReleaseDevice();
-    gpio_set_level(TEN, LOW);
+    PinSet(TEN, LOW);
     vTaskDelay(1 / portTICK_PERIOD_MS);
+
+#if CONFIG_IDF_TARGET_LINUX
+    PinSet(TEN, HIGH);
+    if (!RunChecks()) exit(1);
+    ProfilePrimitives();
+    exit(0);
+#endif
 }
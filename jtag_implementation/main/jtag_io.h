@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#define HIGH 1
+#define LOW 0
+
+// JTAG pins are from the perspective of the MSP430
+#define RST 16 // MSP430 reset                     (RX)  ->  (16)
+#define TMS 17 // JTAG state machine control       (TX)  ->  (7)
+#define TCK 18 // JTAG clock input                 (MO)  ->  (6)
+#define TDI 19 // JTAG data input and TCLK input   (MI)  ->  (14)
+#define TDO 21 // JTAG data output                 (21)  ->  (15)
+#define TEN 22 // JTAG enable                      (SCL) ->  (17)
+
+// Spy-Bi-Wire shares the TEST and RST/NMI lines
+#define SBWTCK TEN  // Spy-Bi-Wire clock
+#define SBWTDIO RST // Spy-Bi-Wire data, driven by the target in the TDO slot
+
+#define PIN_MASK(pin) (1UL << (pin))
+
+/*
+    Pin backend used by the JTAG core. On the ESP32 the
+    calls map straight onto the GPIO driver. In a linux
+    target build (idf.py --preview set-target linux) they
+    are served by the simulated MSP430 in jtag_sim.c, so
+    the same core can be measured without a board.
+*/
+
+/*
+    Configures the JTAG pins: TDO as a pulled-down input,
+    RST as an output that can also be read back for
+    Spy-Bi-Wire, everything else as an output.
+*/
+void PinInit(void);
+
+// configures the TDO input of a further target for gang mode
+void PinInitTdo(int pin);
+
+/*
+    Pin access goes two ways. PinSet/PinGet drive a single
+    pin through the GPIO driver. PortSet/PortClr/PortIn/
+    PortOut act on a mask of pins at once through the
+    W1TS/W1TC, IN and OUT registers, with one store or
+    load each. All JTAG pins are below GPIO 32, so a
+    single 32-bit register covers them. PortRelease/
+    PortDrive turn the output drivers of mask off and on
+    through ENABLE_W1TC/W1TS, for the Spy-Bi-Wire data
+    line turnaround.
+*/
+
+/*
+    SPI path for the data bits of a scan, with the SPI
+    clock as TCK, MOSI as TDI and MISO as TDO (mode 0).
+    SpiInit sets up the peripheral and leaves the pins
+    with GPIO. SpiAttach routes TCK and TDI to the SPI
+    peripheral and SpiDetach hands them back; TDO stays
+    connected to both. SpiTransfer clocks out bits of
+    data MSB first and returns TDO the same way.
+    SpiSetClock changes the clock after SpiInit.
+*/
+bool SpiInit(int clock_hz);
+bool SpiSetClock(int clock_hz);
+void SpiAttach(void);
+void SpiDetach(void);
+uint32_t SpiTransfer(uint32_t data, int bits);
+
+/*
+    DMA waveform output for jtag_wave.c. TMS, TCK and TDI
+    are driven from a buffer of samples at twice the TCK
+    rate, while TDO is sampled on every rising TCK edge
+    into tdo, MSB first within each byte. The peripheral's
+    lines idle low, so the pins are dropped low before the
+    handover; afterwards GPIO takes over at the levels of
+    the last sample.
+*/
+bool WavePortInit(int tck_hz);
+void WavePlay(const uint8_t *samples, size_t count, uint8_t *tdo, size_t tdo_bytes);
+
+/*
+    Busy-waits at least ns nanoseconds, for edges that
+    must follow a set rate such as the TCLK strobes of
+    the flash timing generator. The simulator does not
+    wait, since its time only moves with the pins.
+*/
+
+#if CONFIG_IDF_TARGET_LINUX
+
+void PinSet(int pin, uint32_t level);
+int PinGet(int pin);
+void PortSet(uint32_t mask);
+void PortClr(uint32_t mask);
+uint32_t PortIn(void);
+uint32_t PortOut(void);
+void PortRelease(uint32_t mask);
+void PortDrive(uint32_t mask);
+void DelayNs(uint32_t ns);
+
+#else
+
+#include "driver/gpio.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+
+static inline void PinSet(int pin, uint32_t level) {
+    gpio_set_level((gpio_num_t) pin, level);
+}
+
+static inline int PinGet(int pin) {
+    return gpio_get_level((gpio_num_t) pin);
+}
+
+static inline void PortSet(uint32_t mask) {
+    REG_WRITE(GPIO_OUT_W1TS_REG, mask);
+}
+
+static inline void PortClr(uint32_t mask) {
+    REG_WRITE(GPIO_OUT_W1TC_REG, mask);
+}
+
+static inline uint32_t PortIn(void) {
+    return REG_READ(GPIO_IN_REG);
+}
+
+static inline uint32_t PortOut(void) {
+    return REG_READ(GPIO_OUT_REG);
+}
+
+static inline void PortRelease(uint32_t mask) {
+    REG_WRITE(GPIO_ENABLE_W1TC_REG, mask);
+}
+
+static inline void PortDrive(uint32_t mask) {
+    REG_WRITE(GPIO_ENABLE_W1TS_REG, mask);
+}
+
+static inline void DelayNs(uint32_t ns) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    uint32_t cycles = ns * esp_rom_get_cpu_ticks_per_us() / 1000;
+    while (esp_cpu_get_cycle_count() - start < cycles) {
+    }
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include "driver/gpio.h"
+#include "jtag_io.h"
+
+#define INPUT GPIO_MODE_INPUT
+#define OUTPUT GPIO_MODE_OUTPUT
+#define INPUT_OUTPUT GPIO_MODE_INPUT_OUTPUT
+
+void PinInit(void) {
+    gpio_reset_pin(RST);
+    gpio_reset_pin(TMS);
+    gpio_reset_pin(TCK);
+    gpio_reset_pin(TDI);
+    gpio_reset_pin(TDO);
+    gpio_reset_pin(TEN);
+    gpio_set_direction(RST, INPUT_OUTPUT);
+    gpio_set_direction(TMS, OUTPUT);
+    gpio_set_direction(TCK, OUTPUT);
+    gpio_set_direction(TDI, OUTPUT);
+    gpio_set_direction(TDO, INPUT);
+    gpio_set_direction(TEN, OUTPUT);
+    gpio_set_pull_mode(TDO, GPIO_PULLDOWN_ONLY);
+}
+
+void PinInitTdo(int pin) {
+    gpio_reset_pin(pin);
+    gpio_set_direction(pin, INPUT);
+    gpio_set_pull_mode(pin, GPIO_PULLDOWN_ONLY);
+}
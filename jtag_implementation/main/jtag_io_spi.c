@@ -0,0 +1,73 @@
+#include <string.h>
+#include "driver/spi_master.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/spi_periph.h"
+#include "jtag_io.h"
+
+#define SPI_HOST_ID SPI2_HOST
+
+static spi_device_handle_t spi;
+
+static bool AddDevice(int clock_hz) {
+    spi_device_interface_config_t dev = {
+        .mode = 0, // TDI sampled on rising TCK, TDO changes on falling
+        .clock_speed_hz = clock_hz,
+        .spics_io_num = -1,
+        .queue_size = 1,
+    };
+    if (spi_bus_add_device(SPI_HOST_ID, &dev, &spi) != ESP_OK) {
+        spi = NULL;
+        return false;
+    }
+    // polling transfers only, so keep the bus for good
+    spi_device_acquire_bus(spi, portMAX_DELAY);
+    return true;
+}
+
+bool SpiInit(int clock_hz) {
+    spi_bus_config_t bus = {
+        .mosi_io_num = TDI,
+        .miso_io_num = TDO,
+        .sclk_io_num = TCK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = 4,
+    };
+    if (spi_bus_initialize(SPI_HOST_ID, &bus, SPI_DMA_DISABLED) != ESP_OK) return false;
+    if (!AddDevice(clock_hz)) return false;
+    SpiDetach();
+    return true;
+}
+
+// the clock is fixed per device, so the device is added again
+bool SpiSetClock(int clock_hz) {
+    if (spi == NULL) return false;
+    spi_device_release_bus(spi);
+    spi_bus_remove_device(spi);
+    return AddDevice(clock_hz);
+}
+
+void SpiAttach(void) {
+    esp_rom_gpio_connect_out_signal(TCK, spi_periph_signal[SPI_HOST_ID].spiclk_out, false, false);
+    esp_rom_gpio_connect_out_signal(TDI, spi_periph_signal[SPI_HOST_ID].spid_out, false, false);
+}
+
+void SpiDetach(void) {
+    esp_rom_gpio_connect_out_signal(TCK, SIG_GPIO_OUT_IDX, false, false);
+    esp_rom_gpio_connect_out_signal(TDI, SIG_GPIO_OUT_IDX, false, false);
+}
+
+uint32_t SpiTransfer(uint32_t data, int bits) {
+    spi_transaction_t t = {
+        .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA,
+        .length = bits,
+        .rxlength = bits,
+    };
+    uint32_t tx = SPI_SWAP_DATA_TX(data, bits);
+    memcpy(t.tx_data, &tx, sizeof(tx));
+    spi_device_polling_transmit(spi, &t);
+    uint32_t rx;
+    memcpy(&rx, t.rx_data, sizeof(rx));
+    return SPI_SWAP_DATA_RX(rx, bits);
+}
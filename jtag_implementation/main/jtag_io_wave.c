@@ -0,0 +1,129 @@
+#include "driver/gpio.h"
+#include "driver/spi_slave.h"
+#include "esp_lcd_panel_io.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "jtag_io.h"
+#include "jtag_wave.h"
+
+/*
+    Samples are sent by I2S0 in parallel (LCD) mode through
+    the esp_lcd i80 bus, with data lines D0-D2 on TMS, TCK
+    and TDI. TDO is captured by SPI3 in slave mode, clocked
+    by our own TCK and selected by WAVE_CS for the length
+    of a transfer, so each received bit lines up with one
+    TCK cycle no matter when DMA starts.
+
+    The i80 bus insists on a WR strobe, a DC line and all
+    eight data lines; none of those is connected.
+*/
+#define WAVE_WR 25    // I2S pixel clock, unconnected
+#define WAVE_DC 26    // I2S DC and data lines D3-D7, unconnected
+#define WAVE_CS 27    // SPI slave select, unconnected, driven by us
+#define WAVE_RX_HOST SPI3_HOST
+
+#define WAVE_PINS (PIN_MASK(TMS) | PIN_MASK(TCK) | PIN_MASK(TDI))
+#define OUT_SEL_REG(pin) (GPIO_FUNC0_OUT_SEL_CFG_REG + (pin) * 4)
+
+static esp_lcd_panel_io_handle_t io;
+static SemaphoreHandle_t tx_done;
+static uint32_t out_sel[3]; // I2S routing of TMS, TCK and TDI
+static const int wave_pins[3] = {TMS, TCK, TDI};
+
+static bool TxDone(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *ctx) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(tx_done, &woken);
+    return woken == pdTRUE;
+}
+
+static void WaveAttach(void) {
+    for (int i = 0; i < 3; i++) {
+        REG_WRITE(OUT_SEL_REG(wave_pins[i]), out_sel[i]);
+    }
+}
+
+static void WaveDetach(void) {
+    for (int i = 0; i < 3; i++) {
+        REG_WRITE(OUT_SEL_REG(wave_pins[i]), SIG_GPIO_OUT_IDX);
+    }
+}
+
+bool WavePortInit(int tck_hz) {
+    tx_done = xSemaphoreCreateBinary();
+    if (tx_done == NULL) return false;
+
+    esp_lcd_i80_bus_handle_t bus;
+    esp_lcd_i80_bus_config_t bus_config = {
+        .clk_src = LCD_CLK_SRC_DEFAULT,
+        .dc_gpio_num = WAVE_DC,
+        .wr_gpio_num = WAVE_WR,
+        .data_gpio_nums = {TMS, TCK, TDI, WAVE_DC, WAVE_DC, WAVE_DC, WAVE_DC, WAVE_DC},
+        .bus_width = 8,
+        .max_transfer_bytes = WAVE_MAX_SAMPLES,
+    };
+    if (esp_lcd_new_i80_bus(&bus_config, &bus) != ESP_OK) return false;
+
+    esp_lcd_panel_io_i80_config_t io_config = {
+        .cs_gpio_num = -1,
+        .pclk_hz = tck_hz * 2, // two samples per TCK cycle
+        .trans_queue_depth = 1,
+        .on_color_trans_done = TxDone,
+        .lcd_cmd_bits = 8,
+        .lcd_param_bits = 8,
+    };
+    if (esp_lcd_new_panel_io_i80(bus, &io_config, &io) != ESP_OK) return false;
+
+    spi_bus_config_t rx_bus = {
+        .mosi_io_num = TDO,
+        .miso_io_num = -1,
+        .sclk_io_num = TCK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+    };
+    spi_slave_interface_config_t rx_config = {
+        .mode = 3, // TCK idles high, TDO sampled on the rising edge
+        .spics_io_num = WAVE_CS,
+        .queue_size = 1,
+    };
+    if (spi_slave_initialize(WAVE_RX_HOST, &rx_bus, &rx_config, SPI_DMA_CH_AUTO) != ESP_OK) return false;
+
+    // the slave claims TCK and CS as inputs, keep driving them
+    gpio_set_direction(TCK, GPIO_MODE_INPUT_OUTPUT);
+    gpio_set_direction(WAVE_CS, GPIO_MODE_INPUT_OUTPUT);
+    gpio_set_level(WAVE_CS, HIGH);
+
+    for (int i = 0; i < 3; i++) {
+        out_sel[i] = REG_READ(OUT_SEL_REG(wave_pins[i]));
+    }
+    WaveDetach();
+    return true;
+}
+
+void WavePlay(const uint8_t *samples, size_t count, uint8_t *tdo, size_t tdo_bytes) {
+    spi_slave_transaction_t rx = {
+        .length = tdo_bytes * 8,
+        .rx_buffer = tdo,
+    };
+    spi_slave_queue_trans(WAVE_RX_HOST, &rx, portMAX_DELAY);
+
+    PortClr(WAVE_PINS);
+    gpio_set_level(WAVE_CS, LOW);
+    WaveAttach();
+    esp_lcd_panel_io_tx_color(io, -1, samples, count);
+    xSemaphoreTake(tx_done, portMAX_DELAY);
+
+    // hold the last sample on GPIO before taking the pins back
+    uint8_t last = count ? samples[count - 1] : 0;
+    uint32_t high = ((last & WAVE_TMS) ? PIN_MASK(TMS) : 0) |
+                    ((last & WAVE_TCK) ? PIN_MASK(TCK) : 0) |
+                    ((last & WAVE_TDI) ? PIN_MASK(TDI) : 0);
+    PortSet(high);
+    PortClr(WAVE_PINS & ~high);
+    WaveDetach();
+    gpio_set_level(WAVE_CS, HIGH);
+
+    spi_slave_transaction_t *done;
+    spi_slave_get_trans_result(WAVE_RX_HOST, &done, portMAX_DELAY);
+}
@@ -0,0 +1,108 @@
+#define _GNU_SOURCE // posix_openpt and ptsname on the linux target
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "jtag_link.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#else
+#include "driver/uart.h"
+#endif
+
+#if CONFIG_IDF_TARGET_LINUX
+static int pty_fd = -1;
+static int pty_slave = -1;
+
+static int PtyRead(uint8_t *data, int max, int timeout_ms) {
+    struct pollfd fd = {.fd = pty_fd, .events = POLLIN};
+    if (poll(&fd, 1, timeout_ms) <= 0) return 0;
+    int count = read(pty_fd, data, max);
+    return count > 0 ? count : -1;
+}
+
+static void PtyWrite(const uint8_t *data, int length) {
+    while (length > 0) {
+        int count = write(pty_fd, data, length);
+        if (count <= 0) return;
+        data += count;
+        length -= count;
+    }
+}
+
+static const link_t pty_link = {PtyRead, PtyWrite};
+
+const link_t *LinkOpenPty(void) {
+    pty_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_fd < 0 || grantpt(pty_fd) != 0 || unlockpt(pty_fd) != 0) {
+        printf("Link: no pseudo terminal\n");
+        return NULL;
+    }
+    // holding the other end open keeps the pty up between clients
+    pty_slave = open(ptsname(pty_fd), O_RDWR | O_NOCTTY);
+    struct termios raw;
+    tcgetattr(pty_slave, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(pty_slave, TCSANOW, &raw);
+    printf("Link: %s\n", ptsname(pty_fd));
+    fflush(stdout);
+    return &pty_link;
+}
+
+void LinkClose(void) {
+    close(pty_slave);
+    close(pty_fd);
+    pty_fd = -1;
+}
+#else
+static int uart_num = -1;
+
+static int UartRead(uint8_t *data, int max, int timeout_ms) {
+    // uart_read_bytes waits for all max bytes, so only the first one waits here
+    TickType_t wait = timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    int count = uart_read_bytes(uart_num, data, 1, wait);
+    if (count <= 0) return count < 0 ? -1 : 0;
+    size_t buffered = 0;
+    uart_get_buffered_data_len(uart_num, &buffered);
+    if (buffered > (size_t) max - 1) buffered = max - 1;
+    if (buffered == 0) return 1;
+    int rest = uart_read_bytes(uart_num, data + 1, buffered, 0);
+    return rest > 0 ? 1 + rest : 1;
+}
+
+static void UartWrite(const uint8_t *data, int length) {
+    uart_write_bytes(uart_num, data, length);
+}
+
+static const link_t uart_link = {UartRead, UartWrite};
+
+const link_t *LinkOpenUart(int num, int baud, int tx_pin, int rx_pin, int rx_buffer) {
+    // no TX buffer: writes wait for the FIFO, in order with the console
+    if (uart_driver_install(num, rx_buffer, 0, 0, NULL, 0) != ESP_OK) return NULL;
+    uart_num = num;
+    if (baud == 0) return &uart_link;
+
+    uart_config_t config = {
+        .baud_rate = baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    if (uart_param_config(num, &config) != ESP_OK ||
+        uart_set_pin(num, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        LinkClose();
+        return NULL;
+    }
+    return &uart_link;
+}
+
+void LinkClose(void) {
+    uart_driver_delete(uart_num);
+    uart_num = -1;
+}
+#endif
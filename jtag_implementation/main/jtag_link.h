@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Byte stream to a host tool: a UART on the device, a
+    pseudo terminal on the linux target. The GDB server
+    and the command server run on it. One link is open at
+    a time.
+*/
+
+typedef struct {
+    /*
+        Reads up to max bytes, waiting up to timeout_ms for
+        the first, or for ever if timeout_ms is negative.
+
+        Returns: bytes read, 0 on timeout, -1 once closed.
+    */
+    int (*read)(uint8_t *data, int max, int timeout_ms);
+    void (*write)(const uint8_t *data, int length);
+} link_t;
+
+/*
+    Opens uart_num with rx_buffer bytes of receive buffer.
+    A baud of 0 keeps the configuration and pins the UART
+    has, as for the console. Writes return once the bytes
+    are in the FIFO, so console output cannot land in the
+    middle of them. Not available on the linux target.
+
+    Returns: NULL if the driver could not be set up.
+*/
+const link_t *LinkOpenUart(int uart_num, int baud, int tx_pin, int rx_pin, int rx_buffer);
+
+/*
+    Opens a pseudo terminal and prints its name for the
+    host tool to connect to. Linux target only.
+
+    Returns: NULL if none could be opened.
+*/
+const link_t *LinkOpenPty(void);
+
+void LinkClose(void);
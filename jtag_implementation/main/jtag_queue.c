@@ -0,0 +1,200 @@
+#include <stddef.h>
+#include "jtag_engine.h"
+#include "jtag_io.h"
+#include "jtag_queue.h"
+#include "jtag_tap.h"
+#include "jtag_trace.h"
+
+typedef enum {
+    CMD_SCAN,
+    CMD_TCLK,
+    CMD_TMS,
+    CMD_IDLE,
+    CMD_RESET,
+} cmd_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t reg;
+    uint8_t bits;
+    uint8_t order;
+    uint8_t size;
+    uint32_t data; // scan data, TCLK level, TMS bits or idle clocks
+    void *dest;
+} queue_cmd_t;
+
+static queue_cmd_t queue[QUEUE_SIZE];
+static int queue_count = 0;
+static uint8_t current_ir = 0xFF; // IR_BYPASS after reset
+
+static queue_cmd_t *Append(void) {
+    if (queue_count == QUEUE_SIZE) QueueFlush();
+    return &queue[queue_count++];
+}
+
+void QueueScan(scan_reg_t reg, uint32_t data, int bits, bit_order_t order,
+               void *dest, int size) {
+    queue_cmd_t *cmd = Append();
+    cmd->type = CMD_SCAN;
+    cmd->reg = reg;
+    cmd->data = data;
+    cmd->bits = bits;
+    cmd->order = order;
+    cmd->dest = dest;
+    cmd->size = size;
+    // IR_SHIFT passes the instruction reversed, MSB first
+    if (reg == SCAN_IR) current_ir = order == MSB_FIRST ? ReverseBits(data, bits) : data;
+}
+
+void QueueIR(uint8_t instruction) {
+    QueueScan(SCAN_IR, instruction, 8, LSB_FIRST, NULL, 0);
+}
+
+void QueueDR(uint16_t data, uint16_t *dest) {
+    QueueScan(SCAN_DR, data, 16, MSB_FIRST, dest, sizeof(*dest));
+}
+
+static void QueueTclk(uint32_t level) {
+    queue_cmd_t *cmd = Append();
+    cmd->type = CMD_TCLK;
+    cmd->data = level;
+}
+
+uint8_t QueueCurrentIR(void) {
+    return current_ir;
+}
+
+void QueueClrTCLK(void) {
+    QueueTclk(LOW);
+}
+
+void QueueSetTCLK(void) {
+    QueueTclk(HIGH);
+}
+
+void QueueTms(uint32_t tms, int count) {
+    queue_cmd_t *cmd = Append();
+    cmd->type = CMD_TMS;
+    cmd->data = tms;
+    cmd->bits = count;
+}
+
+void QueueIdle(int clocks) {
+    queue_cmd_t *cmd = Append();
+    cmd->type = CMD_IDLE;
+    cmd->data = clocks;
+}
+
+void QueueResetTap(void) {
+    queue_cmd_t *cmd = Append();
+    cmd->type = CMD_RESET;
+    current_ir = 0xFF;
+}
+
+static void Store(const queue_cmd_t *cmd, uint32_t value) {
+    if (cmd->size == 1) {
+        *(uint8_t *) cmd->dest = value;
+    } else if (cmd->size == 2) {
+        *(uint16_t *) cmd->dest = value;
+    } else {
+        *(uint32_t *) cmd->dest = value;
+    }
+}
+
+/*
+    Flush state. TMS cycles are collected in a pending
+    path and only clocked before a shift or a TCLK edge,
+    so the exit of one scan and the entry of the next
+    take a single engine call.
+*/
+typedef struct {
+    const jtag_engine_t *engine;
+    tap_state_t state; // once the pending path is clocked
+    uint32_t tms;      // pending path, LSB first
+    int count;
+    int tclk;
+    int tdi;           // last bit of a scan until TCLK is restored
+} flush_t;
+
+static void Clock(flush_t *f) {
+    if (f->count > 0) f->engine->tms(f->tms, f->count);
+    f->tms = 0;
+    f->count = 0;
+}
+
+static void Path(flush_t *f, uint32_t tms, int count) {
+    bool idle = false;
+    for (int i = 0; i < count; i++) {
+        f->state = TapNext(f->state, (tms >> i) & 0x01);
+        idle |= f->state == TAP_IDLE;
+    }
+    // TDI is TCLK in Run/Idle, so put the level back before getting there
+    if (idle && f->tdi != f->tclk) {
+        f->engine->set_tdi(f->tclk);
+        f->tdi = f->tclk;
+    }
+    if (f->count + count > 32) Clock(f);
+    f->tms |= tms << f->count;
+    f->count += count;
+}
+
+static void Goto(flush_t *f, tap_state_t state) {
+    uint32_t tms;
+    int count = TapPath(f->state, state, &tms);
+    Path(f, tms, count);
+}
+
+void QueueFlush(void) {
+    uint32_t start = TraceNow();
+    flush_t f = {.engine = GetShiftEngine(), .state = TAP_IDLE};
+    f.tclk = f.engine->get_tdi();
+    f.tdi = f.tclk;
+
+    for (int i = 0; i < queue_count; i++) {
+        const queue_cmd_t *cmd = &queue[i];
+        switch (cmd->type) {
+        case CMD_TCLK:
+            // TCLK only moves in Run/Idle, so finish the path first
+            Goto(&f, TAP_IDLE);
+            Clock(&f);
+            if ((int) cmd->data != f.tdi) f.engine->set_tdi(cmd->data);
+            f.tclk = cmd->data;
+            f.tdi = f.tclk;
+            continue;
+        case CMD_TMS:
+            Goto(&f, TAP_IDLE);
+            Path(&f, cmd->data, cmd->bits);
+            continue;
+        case CMD_IDLE:
+            Goto(&f, TAP_IDLE);
+            for (uint32_t left = cmd->data; left > 0; left -= left > 32 ? 32 : left) {
+                Path(&f, 0, left > 32 ? 32 : left);
+            }
+            continue;
+        case CMD_RESET:
+            Path(&f, 0x3F, 6); // reaches Test-Logic-Reset from any state
+            continue;
+        }
+
+        uint32_t data = cmd->data;
+        if (cmd->order == LSB_FIRST) data = ReverseBits(data, cmd->bits);
+
+        Goto(&f, cmd->reg == SCAN_IR ? TAP_SHIFT_IR : TAP_SHIFT_DR);
+        Clock(&f);
+        bool deferred = cmd->dest != NULL && f.engine->capture != NULL;
+        if (deferred) f.engine->capture(cmd->dest, cmd->size, cmd->bits, cmd->order);
+        uint32_t ret = f.engine->shift(data, cmd->bits);
+        f.tdi = data & 0x01;
+        f.state = cmd->reg == SCAN_IR ? TAP_EXIT1_IR : TAP_EXIT1_DR;
+        Path(&f, 0x01, 1); // 1 (Update)
+
+        if (cmd->dest != NULL && !deferred) {
+            if (cmd->order == LSB_FIRST) ret = ReverseBits(ret, cmd->bits);
+            Store(cmd, ret);
+        }
+    }
+    Goto(&f, TAP_IDLE);
+    Clock(&f);
+    queue_count = 0;
+    TraceLatency(TRACE_QUEUE_FLUSH, start);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include "jtag.h"
+
+/*
+    JTAG command queue. Scans and TCLK edges are appended
+    and only run on QueueFlush, in order, on the current
+    shift engine. Results are written to dest pointers,
+    which must stay valid until the flush; scans whose
+    result is not needed pass NULL.
+
+    Compared to calling IR_SHIFT/DR_SHIFT one by one, a
+    flush reads the TCLK level back once instead of once
+    per scan, only drives TDI when TCLK actually has to be
+    restored, and clocks the exit path of one scan and the
+    entry path of the next as a single TMS sequence. The
+    TAP state is tracked (see jtag_tap.h), so a scan goes
+    from Update straight to the next Shift state, and Run/
+    Idle is only visited for TCLK edges and at the end of
+    the flush. Every flush starts and ends in Run/Idle.
+*/
+
+#define QUEUE_SIZE 128 // commands; a full queue flushes itself
+
+void QueueScan(scan_reg_t reg, uint32_t data, int bits, bit_order_t order,
+               void *dest, int size);
+void QueueIR(uint8_t instruction);
+void QueueDR(uint16_t data, uint16_t *dest);
+/*
+    Instruction of the last IR scan queued, as passed to
+    QueueIR, so callers can skip reloading one that is
+    already selected. Scans recorded into a waveform count
+    as run, so it has to be played.
+*/
+uint8_t QueueCurrentIR(void);
+
+void QueueClrTCLK(void);
+void QueueSetTCLK(void);
+
+/*
+    Queues count TCK cycles with TMS taken from tms, LSB
+    first, for paths that start and end in Run/Idle
+    without a scan. TDI is left unchanged.
+*/
+void QueueTms(uint32_t tms, int count);
+
+/*
+    Queues clocks TCK cycles in Run/Idle, for operations
+    that need the TAP to idle between scans. TDI, and so
+    TCLK, is left unchanged.
+*/
+void QueueIdle(int clocks);
+
+/*
+    Queues six TCK cycles with TMS high, which take the
+    TAP to Test-Logic-Reset from any state and select
+    bypass. The next command leaves through Run/Idle.
+*/
+void QueueResetTap(void);
+
+/*
+    Runs every queued command and fills in the results.
+*/
+void QueueFlush(void);
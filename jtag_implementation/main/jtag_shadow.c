@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <string.h>
+#include "jtag.h"
+#include "jtag_flash.h"
+#include "jtag_shadow.h"
+
+#define SHADOW_PAGES (0x10000 / SHADOW_PAGE)
+#define PAGE_WORDS (SHADOW_PAGE / 2)
+#define SEGMENT_WORDS (FLASH_MAIN_SEGMENT / 2)
+
+static uint16_t shadow[0x10000 / 2];
+static bool valid[SHADOW_PAGES];
+static bool dirty[SHADOW_PAGES];
+
+static void Load(int page) {
+    if (valid[page]) return;
+    ReadMemQuick(page * SHADOW_PAGE, PAGE_WORDS, &shadow[page * PAGE_WORDS]);
+    valid[page] = true;
+}
+
+uint16_t ShadowReadMem(uint16_t addr) {
+    if (addr < SHADOW_START) return ReadMem(addr);
+    Load(addr / SHADOW_PAGE);
+    return shadow[addr / 2];
+}
+
+void ShadowWriteMem(uint16_t addr, uint16_t data) {
+    if (addr < SHADOW_START) {
+        WriteMem(addr, data);
+        return;
+    }
+    int page = addr / SHADOW_PAGE;
+    Load(page);
+    if (shadow[addr / 2] == data) return;
+    shadow[addr / 2] = data;
+    dirty[page] = true;
+}
+
+// bounds of the flash segment holding addr, split as EraseFLASH erases them
+static uint32_t SegmentStart(uint32_t addr) {
+    uint32_t size = addr < FLASH_MAIN_START ? FLASH_INFO_SEGMENT : FLASH_MAIN_SEGMENT;
+    uint32_t start = addr & ~(size - 1);
+    // main memory starts in the middle of a segment
+    if (start < FLASH_MAIN_START && addr >= FLASH_MAIN_START) start = FLASH_MAIN_START;
+    return start;
+}
+
+static uint32_t SegmentEnd(uint32_t addr) {
+    uint32_t size = addr < FLASH_MAIN_START ? FLASH_INFO_SEGMENT : FLASH_MAIN_SEGMENT;
+    return (addr & ~(size - 1)) + size;
+}
+
+/*
+    Brings one segment from old to new contents. Words
+    that only clear bits are programmed over the old data,
+    anything else needs the segment erased first.
+*/
+static bool Rewrite(uint16_t start, uint16_t count, const uint16_t *old, const uint16_t *new) {
+    if (memcmp(old, new, 2 * count) == 0) return true;
+
+    bool erase = false;
+    for (int i = 0; i < count; i++) {
+        if ((old[i] & new[i]) != new[i]) erase = true;
+    }
+    if (erase) {
+        EraseFLASH(ERASE_SGMT, start);
+        WriteFLASH(start, count, new);
+    } else {
+        int i = 0;
+        while (i < count) {
+            if (old[i] == new[i]) {
+                i++;
+                continue;
+            }
+            int run = 0;
+            while (i + run < count && old[i + run] != new[i + run]) run++;
+            WriteFLASH(start + 2 * i, run, &new[i]);
+            i += run;
+        }
+    }
+    return VerifyPSA(start, count, new);
+}
+
+/*
+    Writes the dirty pages of one segment and the image
+    words falling into it, at [addr, addr + 2 * length).
+*/
+static bool ProgramSegment(uint32_t start, uint32_t end, uint16_t addr, uint16_t length,
+                           const uint16_t *image) {
+    uint16_t count = (end - start) / 2;
+    int first = start / SHADOW_PAGE;
+    int last = (end - 1) / SHADOW_PAGE;
+    bool known = true;
+    bool changed = false;
+    for (int page = first; page <= last; page++) {
+        if (!valid[page]) known = false;
+        if (dirty[page]) changed = true;
+    }
+    // a segment never read is compared on the target, without reading it
+    if (!known && !changed && length > 0 && VerifyPSA(addr, length, image)) {
+        for (int page = first; page <= last; page++) {
+            uint32_t page_addr = page * SHADOW_PAGE;
+            if (page_addr < addr || page_addr + SHADOW_PAGE > addr + 2u * length) continue;
+            memcpy(&shadow[page * PAGE_WORDS], &image[(page_addr - addr) / 2], SHADOW_PAGE);
+            valid[page] = true;
+        }
+        return true;
+    }
+
+    // dirty pages no longer show what the flash holds
+    uint16_t old[SEGMENT_WORDS];
+    if (known && !changed) {
+        memcpy(old, &shadow[start / 2], 2 * count);
+    } else {
+        ReadMemQuick(start, count, old);
+    }
+    for (int page = first; page <= last; page++) {
+        if (valid[page]) continue;
+        uint32_t offset = page * SHADOW_PAGE - start;
+        memcpy(&shadow[page * PAGE_WORDS], &old[offset / 2], SHADOW_PAGE);
+        valid[page] = true;
+    }
+
+    uint16_t *new = &shadow[start / 2];
+    if (length > 0) memcpy(&new[(addr - start) / 2], image, 2 * length);
+    bool ok = Rewrite(start, count, old, new);
+    for (int page = first; page <= last; page++) {
+        dirty[page] = false;
+        if (!ok) valid[page] = false; // the flash holds neither version
+    }
+    return ok;
+}
+
+bool ShadowProgram(uint16_t addr, uint16_t length, const uint16_t *image) {
+    bool ok = true;
+    uint32_t end = addr + 2 * length;
+    if (addr < FLASH_INFO_START || end > 0x10000) {
+        printf("Shadow: 0x%.5lx-0x%.5lx is not flash\n", (unsigned long) addr, (unsigned long) end);
+        return false;
+    }
+    uint32_t lo = addr;
+    while (lo < end) {
+        uint32_t start = SegmentStart(lo);
+        uint32_t next = SegmentEnd(lo);
+        uint32_t hi = next < end ? next : end;
+        ok = ProgramSegment(start, next, lo, (hi - lo) / 2, &image[(lo - addr) / 2]) && ok;
+        lo = next;
+    }
+    return ok;
+}
+
+bool ShadowFlush(void) {
+    bool ok = true;
+    int page = SHADOW_START / SHADOW_PAGE;
+    while (page < SHADOW_PAGES) {
+        uint32_t addr = page * SHADOW_PAGE;
+        if (!dirty[page]) {
+            page++;
+        } else if (addr >= FLASH_INFO_START) {
+            uint32_t end = SegmentEnd(addr);
+            ok = ProgramSegment(SegmentStart(addr), end, addr, 0, NULL) && ok;
+            page = end / SHADOW_PAGE;
+        } else {
+            int count = 0;
+            while ((page + count) * SHADOW_PAGE < FLASH_INFO_START && dirty[page + count]) {
+                dirty[page + count] = false;
+                count++;
+            }
+            WriteMemQuick(addr, count * PAGE_WORDS, &shadow[addr / 2]);
+            page += count;
+        }
+    }
+    return ok;
+}
+
+void ShadowInvalidate(void) {
+    for (int page = 0; page < FLASH_INFO_START / SHADOW_PAGE; page++) {
+        valid[page] = false;
+        dirty[page] = false;
+    }
+}
+
+void ShadowReset(void) {
+    memset(valid, 0, sizeof(valid));
+    memset(dirty, 0, sizeof(dirty));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Host-side copy of the 16-bit target address space, kept
+    in pages of SHADOW_PAGE bytes. A page is read from the
+    target in one quick block the first time it is used
+    and served from the copy after that. Writes only touch
+    the copy and mark the page dirty until ShadowFlush
+    writes dirty pages back, consecutive pages as one
+    block.
+
+    Peripheral registers below SHADOW_START are never
+    cached. RAM pages go stale whenever the CPU runs, so
+    call ShadowInvalidate after releasing it; flash pages
+    stay valid since flash only changes through the
+    controller.
+*/
+
+#define SHADOW_START 0x0200 // first cached address, below it sit peripherals
+#define SHADOW_PAGE 64      // bytes; divides every flash segment
+
+uint16_t ShadowReadMem(uint16_t addr);
+void ShadowWriteMem(uint16_t addr, uint16_t data);
+
+/*
+    Writes every dirty page back: RAM with quick block
+    writes, flash through ShadowProgram.
+
+    Returns: false if a flash page failed to verify.
+*/
+bool ShadowFlush(void);
+
+/*
+    Drops the cached RAM pages, or every page, e.g. after
+    a different device is attached. Dirty pages are lost.
+*/
+void ShadowInvalidate(void);
+void ShadowReset(void);
+
+/*
+    Programs an image into flash, touching only the
+    segments whose contents differ. A segment the copy
+    does not hold yet is checked with VerifyPSA first and
+    skipped if it matches. A differing segment is
+    rewritten in place when its words only lose bits,
+    otherwise erased and rewritten with the data outside
+    the image kept. Reflashing a slightly changed image
+    costs a PSA pass plus the changed segments, instead of
+    erasing and writing all of it.
+
+    Returns: true if every rewritten segment verifies,
+    false without touching the target if the image does
+    not lie in flash.
+*/
+bool ShadowProgram(uint16_t addr, uint16_t length, const uint16_t *image);
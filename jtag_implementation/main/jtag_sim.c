@@ -0,0 +1,977 @@
+#include <stdbool.h>
+#include <string.h>
+#include "jtag.h"
+#include "jtag_io.h"
+#include "jtag_sim.h"
+#include "jtag_wave.h"
+
+#define SIM_JTAG_ID 0x89
+#define SIM_MEM_WORDS 0x80000 // 1 MB, the MSP430X address space
+
+// JTAG control signal register bits (SLAU320, Table 2-5)
+#define CNTRL_RW 0x0001
+#define CNTRL_HALT_JTAG 0x0008
+#define CNTRL_INSTR_LOAD 0x0080
+#define CNTRL_TCE 0x0200
+#define CNTRL_TCE1 0x0400
+#define CNTRL_POR 0x0800
+#define CNTRL_RELEASE_LBYTE 0x1000
+
+// Flash controller registers and bits (SLAU144, chapter 7)
+#define FCTL1 0x0128
+#define FCTL2 0x012A
+#define FCTL3 0x012C
+#define FCTL1_ERASE 0x0002
+#define FCTL1_MERAS 0x0004
+#define FCTL1_WRT 0x0040
+#define FCTL1_BLKWRT 0x0080
+#define FCTL3_BUSY 0x0001
+#define FCTL3_KEYV 0x0002
+#define FCTL3_ACCVIFG 0x0004
+#define FCTL3_WAIT 0x0008
+#define FCTL3_LOCK 0x0010
+#define FLASH_INFO 0x1000
+#define FLASH_MAIN 0x1100
+
+// time one GPIO register store takes on the ESP32
+#define SIM_STORE_NS 25
+
+// targets on shared lines for gang programming
+#define SIM_GANG_MAX 4
+
+// longest SBWTCK low phase of a Spy-Bi-Wire slot, longer ones start an entry sequence
+#define SIM_SBW_LOW_MAX_NS 7000
+
+// instructions the free-running CPU executes per TCK cycle
+#define SIM_CPU_STEPS_PER_TCK 2
+
+// status register flags
+#define SR_C 0x0001
+#define SR_Z 0x0002
+#define SR_N 0x0004
+#define SR_V 0x0100
+
+// timing generator cycles an operation takes (MSP430F2xx)
+#define FLASH_WORD_CYCLES 30
+#define FLASH_BLOCK_FIRST_CYCLES 25
+#define FLASH_BLOCK_NEXT_CYCLES 18
+#define FLASH_BLOCK_END_CYCLES 6
+#define FLASH_SEGMENT_CYCLES 4819
+#define FLASH_MASS_CYCLES 10593
+
+typedef enum {
+    TAP_RESET, TAP_IDLE,
+    TAP_SELECT_DR, TAP_CAPTURE_DR, TAP_SHIFT_DR, TAP_EXIT1_DR,
+    TAP_PAUSE_DR, TAP_EXIT2_DR, TAP_UPDATE_DR,
+    TAP_SELECT_IR, TAP_CAPTURE_IR, TAP_SHIFT_IR, TAP_EXIT1_IR,
+    TAP_PAUSE_IR, TAP_EXIT2_IR, TAP_UPDATE_IR,
+} tap_state_t;
+
+// next state indexed by [state][TMS]
+static const tap_state_t tap_next[16][2] = {
+    [TAP_RESET]      = {TAP_IDLE, TAP_RESET},
+    [TAP_IDLE]       = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_DR]  = {TAP_CAPTURE_DR, TAP_SELECT_IR},
+    [TAP_CAPTURE_DR] = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_SHIFT_DR]   = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_EXIT1_DR]   = {TAP_PAUSE_DR, TAP_UPDATE_DR},
+    [TAP_PAUSE_DR]   = {TAP_PAUSE_DR, TAP_EXIT2_DR},
+    [TAP_EXIT2_DR]   = {TAP_SHIFT_DR, TAP_UPDATE_DR},
+    [TAP_UPDATE_DR]  = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_IR]  = {TAP_CAPTURE_IR, TAP_RESET},
+    [TAP_CAPTURE_IR] = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_SHIFT_IR]   = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_EXIT1_IR]   = {TAP_PAUSE_IR, TAP_UPDATE_IR},
+    [TAP_PAUSE_IR]   = {TAP_PAUSE_IR, TAP_EXIT2_IR},
+    [TAP_EXIT2_IR]   = {TAP_SHIFT_IR, TAP_UPDATE_IR},
+    [TAP_UPDATE_IR]  = {TAP_IDLE, TAP_SELECT_DR},
+};
+
+typedef struct {
+    bool powered;
+    int pins[32];
+    uint32_t out;   // pins as a GPIO OUT register
+    uint32_t released; // pins with the output driver off
+    int tdo;
+    tap_state_t state;
+    uint8_t ir;
+    uint8_t ir_shift;
+    uint32_t dr_shift;
+    int dr_len;
+    int tclk;
+    bool cpux;      // MSP430X: 20-bit address bus and registers
+    uint16_t cntrl; // JTAG control signal register
+    uint32_t mab;   // memory address bus
+    uint16_t mdb;   // memory data bus
+    uint32_t pc;
+    int inject;     // cycle an injected instruction awaits, INJECT_NONE between them
+    int inject_reg;
+    uint32_t inject_addr;  // bits 19-16 of a MOVA immediate, the MOV destination or the JMP target
+    uint16_t inject_value; // Rn as the MOV read it
+    uint16_t psa;   // pseudo-signature analysis register
+    uint16_t fctl[3];
+    int flash_busy;  // TCLK cycles until the flash operation ends
+    bool block_first; // the next block write is the first of a block
+    int ftg_count;   // MCLK cycles towards the next timing generator cycle
+    bool running;    // CPU released from JTAG, running on its own clock
+    sim_hang_t hang; // the sync bit stays clear until this ends
+    int fetch_delay; // TCLK cycles the fetch takes after a sync
+    int fetch_wait;  // TCLK cycles left before the fetch state shows
+    uint16_t r[16];  // CPU registers; R0 lives in pc
+    bool sbw_armed;  // TEST logic enabled, the next TEST pulse selects the interface
+    bool sbw;        // Spy-Bi-Wire on TEST and RST instead of 4-wire JTAG
+    int sbw_slot;    // 0: TMS, 1: TDI, 2: TDO
+    int sbw_tms;
+    int sbw_tdi;
+    bool sbw_tdo;    // the target drives TDO onto RST
+    uint64_t tck_edge_ns; // time of the last TCK edge
+    uint64_t ten_fall_ns; // time TEST last went low
+    uint16_t mem[SIM_MEM_WORDS];
+    sim_stats_t stats;
+} sim_target_t;
+
+/*
+    Targets on the shared TMS, TCK and TDI lines, each with
+    its own TDO pin. sim is the one whose memory, stats and
+    TDO the single-target calls see; pin edges go to all.
+*/
+static sim_target_t targets[SIM_GANG_MAX];
+static int target_tdo[SIM_GANG_MAX] = {TDO};
+static int target_count = 1;
+static sim_target_t *sim = &targets[0];
+static uint64_t time_ns = 0;
+
+// the wiring and ESP32 peripherals, which outlive a target reset
+static uint32_t link_half_ns = 0; // shortest TCK phase the link carries
+static uint32_t spi_half_ns = 0;
+static uint32_t wave_half_ns = 0;
+
+// cycles of the instructions the JTAG routines inject
+enum {
+    INJECT_NONE,
+    INJECT_IMM,   // MOV(A) #imm, Rn: the immediate
+    INJECT_DST,   // MOV Rn, &abs: the destination address
+    INJECT_READ,  // MOV Rn, &abs: Rn goes onto the data bus
+    INJECT_WRITE, // MOV Rn, &abs: the write cycle
+    INJECT_JMP,   // JMP: the cycle that loads the target
+};
+
+static uint16_t GetReg(int reg);
+static void SetReg(int reg, uint16_t value);
+static bool Condition(int cond);
+static void CpuStep();
+
+static uint32_t AddrMask() {
+    return sim->cpux ? 0xFFFFF : 0xFFFF;
+}
+
+static uint16_t MemRead(uint32_t addr) {
+    return sim->mem[(addr & AddrMask()) >> 1];
+}
+
+static void MemWrite(uint32_t addr, uint16_t data) {
+    sim->mem[(addr & AddrMask()) >> 1] = data;
+}
+
+static void FlashViolation() {
+    sim->fctl[2] |= FCTL3_ACCVIFG;
+    sim->stats.flash_violations++;
+}
+
+static void FlashErase(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += 2) {
+        MemWrite(addr, 0xFFFF);
+    }
+}
+
+/*
+    A write into flash memory: erases if ERASE or MERAS is
+    set, programs if WRT is, and is rejected while the
+    controller is locked or still busy with the last
+    operation, which is how missing TCLK strobes show up.
+*/
+static void FlashWrite(uint32_t addr, uint16_t data) {
+    uint16_t fctl1 = sim->fctl[0];
+    if ((sim->fctl[2] & FCTL3_LOCK) || sim->flash_busy > 0) {
+        FlashViolation();
+        return;
+    }
+    uint32_t end = AddrMask() + 1;
+    if (fctl1 & FCTL1_MERAS) {
+        FlashErase((fctl1 & FCTL1_ERASE) ? FLASH_INFO : FLASH_MAIN, end);
+        sim->flash_busy = FLASH_MASS_CYCLES;
+    } else if (fctl1 & FCTL1_ERASE) {
+        uint32_t size = addr < FLASH_MAIN ? 64 : 512;
+        uint32_t start = addr & ~(size - 1);
+        FlashErase(start < FLASH_MAIN && addr >= FLASH_MAIN ? FLASH_MAIN : start, start + size);
+        sim->flash_busy = FLASH_SEGMENT_CYCLES;
+    } else if (fctl1 & FCTL1_WRT) {
+        // programming can only clear bits
+        MemWrite(addr, MemRead(addr) & data);
+        if (!(fctl1 & FCTL1_BLKWRT)) {
+            sim->flash_busy = FLASH_WORD_CYCLES;
+        } else if (sim->block_first) {
+            sim->flash_busy = FLASH_BLOCK_FIRST_CYCLES;
+            sim->block_first = false;
+        } else {
+            sim->flash_busy = FLASH_BLOCK_NEXT_CYCLES;
+        }
+    } else {
+        FlashViolation();
+    }
+}
+
+static void FlashControl(int reg, uint16_t data) {
+    if ((data & 0xFF00) != 0xA500) {
+        sim->fctl[2] |= FCTL3_KEYV;
+        sim->stats.flash_violations++;
+        return;
+    }
+    uint16_t old = sim->fctl[reg];
+    sim->fctl[reg] = data & 0x00FF;
+    if (reg == 0 && (data & FCTL1_BLKWRT) && !(old & FCTL1_BLKWRT)) {
+        sim->block_first = true;
+    } else if (reg == 0 && (old & FCTL1_BLKWRT) && !(data & FCTL1_BLKWRT)) {
+        if (sim->flash_busy > 0) FlashViolation();
+        sim->flash_busy = FLASH_BLOCK_END_CYCLES;
+    }
+}
+
+/*
+    One MCLK cycle: TCLK under JTAG, an instruction when
+    running free. FCTL2 divides it down for the flash
+    timing generator.
+*/
+static void FlashTick() {
+    if (sim->flash_busy == 0) return;
+    if (++sim->ftg_count > (sim->fctl[1] & 0x3F)) {
+        sim->ftg_count = 0;
+        sim->flash_busy--;
+    }
+}
+
+// memory accesses over the JTAG controlled bus, or by the CPU
+static uint16_t BusRead(uint32_t addr) {
+    if (addr >= FCTL1 && addr <= FCTL3) {
+        uint16_t value = 0x9600 | sim->fctl[(addr - FCTL1) >> 1];
+        if (addr == FCTL3 && sim->flash_busy > 0) value |= FCTL3_BUSY;
+        if (addr == FCTL3 && (sim->fctl[0] & FCTL1_BLKWRT) && sim->flash_busy == 0) {
+            value |= FCTL3_WAIT;
+        }
+        return value;
+    }
+    return MemRead(addr);
+}
+
+static void BusWrite(uint32_t addr, uint16_t data) {
+    addr &= AddrMask();
+    if (addr >= FCTL1 && addr <= FCTL3) {
+        FlashControl((addr - FCTL1) >> 1, data);
+    } else if (addr >= FLASH_INFO) {
+        FlashWrite(addr, data);
+    } else {
+        MemWrite(addr, data);
+    }
+}
+
+static uint16_t Status() {
+    uint16_t status = sim->cntrl & ~(CNTRL_TCE | CNTRL_INSTR_LOAD);
+    if ((sim->cntrl & CNTRL_TCE1) && sim->hang == SIM_HANG_NONE) status |= CNTRL_TCE;
+    if (sim->inject == INJECT_NONE && sim->fetch_wait == 0) status |= CNTRL_INSTR_LOAD;
+    return status;
+}
+
+/*
+    Executes one instruction word placed on the data bus
+    through IR_DATA_16BIT. The CPU takes it as fetched at
+    the PC, which moves on 2 for each word, as on the
+    real CPU. Only what the JTAG routines inject is
+    understood: MOV #imm, Rn (0x403n) and, on MSP430X,
+    MOVA #imm20, PC (0x0080) load the next word into the
+    register, MOV Rn, &abs (0x4n82) puts Rn on the data
+    bus and stores it at the next word, and the jumps
+    take two cycles. Anything else is a one-word no-op.
+*/
+static void Execute(uint16_t word) {
+    switch (sim->inject) {
+    case INJECT_IMM:
+        if (sim->inject_reg == 0) {
+            sim->pc = sim->inject_addr | word;
+        } else {
+            sim->pc = (sim->pc + 2) & AddrMask();
+            SetReg(sim->inject_reg, word);
+        }
+        sim->mab = sim->pc;
+        sim->inject = INJECT_NONE;
+        return;
+    case INJECT_DST:
+        sim->pc = (sim->pc + 2) & AddrMask();
+        sim->mab = sim->pc;
+        sim->inject_addr = word;
+        sim->inject = INJECT_READ;
+        return;
+    case INJECT_READ:
+        sim->mdb = sim->inject_value;
+        sim->inject = INJECT_WRITE;
+        return;
+    case INJECT_WRITE:
+        BusWrite(sim->inject_addr, sim->inject_value);
+        sim->inject = INJECT_NONE;
+        return;
+    case INJECT_JMP:
+        sim->pc = sim->inject_addr;
+        sim->mab = sim->pc;
+        sim->inject = INJECT_NONE;
+        return;
+    }
+    sim->pc = (sim->pc + 2) & AddrMask();
+    sim->mab = sim->pc;
+    if ((word & 0xFFF0) == 0x4030) {
+        sim->inject = INJECT_IMM;
+        sim->inject_reg = word & 0x0F;
+        sim->inject_addr = 0;
+    } else if (sim->cpux && (word & 0xF0FF) == 0x0080) {
+        sim->inject = INJECT_IMM;
+        sim->inject_reg = 0;
+        sim->inject_addr = (uint32_t) (word & 0x0F00) << 8;
+    } else if ((word & 0xF0FF) == 0x4082) {
+        sim->inject = INJECT_DST;
+        sim->inject_reg = (word >> 8) & 0x0F;
+        // a PC source reads as the address after the opcode
+        sim->inject_value = GetReg(sim->inject_reg);
+    } else if ((word & 0xE000) == 0x2000) {
+        int offset = word & 0x03FF;
+        if (offset & 0x0200) offset -= 0x0400;
+        bool taken = Condition((word >> 10) & 0x07);
+        sim->inject = INJECT_JMP;
+        sim->inject_addr = taken ? (sim->pc + 2 * offset) & AddrMask() : sim->pc;
+    }
+}
+
+// PSA polynomial 0x0805, as used by the SLAU320 VerifyPSA
+static void PsaStep(uint16_t data) {
+    if (sim->psa & 0x8000) {
+        sim->psa = ((sim->psa ^ 0x0805) << 1) | 0x0001;
+    } else {
+        sim->psa <<= 1;
+    }
+    sim->psa ^= data;
+}
+
+static void TclkRise() {
+    sim->stats.tclk_cycles++;
+    if (sim->fetch_wait > 0) sim->fetch_wait--;
+    FlashTick();
+    if (sim->ir == IR_DATA_QUICK) {
+        // quick access steps the PC and uses it as the address
+        sim->pc += 2;
+        sim->mab = sim->pc;
+    }
+    if (sim->ir == IR_DATA_TO_ADDR || sim->ir == IR_DATA_QUICK) {
+        if (sim->cntrl & CNTRL_RW) {
+            sim->mdb = BusRead(sim->mab);
+        } else {
+            BusWrite(sim->mab, sim->mdb);
+        }
+    } else if (sim->ir == IR_DATA_16BIT) {
+        Execute(sim->mdb);
+    } else if (sim->ir == IR_DATA_CAPTURE && sim->inject != INJECT_NONE) {
+        Execute(sim->mdb); // the injected instruction goes on with its cycles
+    } else if (sim->ir == IR_CNTRL_SIG_CAPTURE && (sim->cntrl & CNTRL_RELEASE_LBYTE) &&
+               !(sim->cntrl & CNTRL_HALT_JTAG)) {
+        CpuStep(); // single step: one instruction per TCLK
+    }
+}
+
+static void SetTclk(int level) {
+    if (level == sim->tclk) return;
+    sim->tclk = level;
+    if (level) TclkRise();
+}
+
+static int DrLength() {
+    if (sim->ir == IR_BYPASS) return 1;
+    if (sim->ir == IR_ADDR_16BIT || sim->ir == IR_ADDR_CAPTURE) {
+        return sim->cpux ? 20 : 16;
+    }
+    if (sim->ir == IR_DATA_TO_ADDR || sim->ir == IR_DATA_16BIT || sim->ir == IR_DATA_QUICK ||
+        sim->ir == IR_DATA_CAPTURE || sim->ir == IR_DATA_PSA || sim->ir == IR_SHIFT_OUT_PSA ||
+        sim->ir == IR_CNTRL_SIG_16BIT || sim->ir == IR_CNTRL_SIG_CAPTURE) {
+        return 16;
+    }
+    return 1;
+}
+
+static uint32_t CaptureDr() {
+    if (sim->ir == IR_ADDR_16BIT || sim->ir == IR_ADDR_CAPTURE) {
+        // MSP430X shifts out bits 15-0 ahead of bits 19-16
+        if (sim->cpux) return ((sim->mab & 0xFFFF) << 4) | (sim->mab >> 16);
+        return sim->mab;
+    }
+    if (sim->ir == IR_DATA_TO_ADDR || sim->ir == IR_DATA_16BIT || sim->ir == IR_DATA_QUICK ||
+        sim->ir == IR_DATA_CAPTURE) {
+        return sim->mdb;
+    }
+    if (sim->ir == IR_CNTRL_SIG_16BIT || sim->ir == IR_CNTRL_SIG_CAPTURE) return Status();
+    if (sim->ir == IR_SHIFT_OUT_PSA) return sim->psa;
+    return 0; // bypass captures 0
+}
+
+static void UpdateDr(uint32_t value) {
+    if (sim->ir == IR_ADDR_16BIT) {
+        sim->mab = value;
+    } else if (sim->ir == IR_DATA_TO_ADDR || sim->ir == IR_DATA_16BIT ||
+               sim->ir == IR_DATA_QUICK) {
+        sim->mdb = value;
+    } else if (sim->ir == IR_CNTRL_SIG_16BIT) {
+        sim->cntrl = value;
+        if (value & CNTRL_TCE1) {
+            sim->running = false;
+            sim->fetch_wait = sim->fetch_delay;
+        }
+        if (value & CNTRL_POR) {
+            if (sim->hang == SIM_HANG_UNTIL_POR) sim->hang = SIM_HANG_NONE;
+            sim->pc = MemRead(0xFFFE);
+            sim->mab = sim->pc;
+            sim->inject = INJECT_NONE;
+        }
+    }
+}
+
+/*
+    Free-running CPU, for code the host loads into RAM and
+    starts with IR_CNTRL_SIG_RELEASE, as on a GDB
+    continue. It covers the word forms of the format I
+    instructions and the jumps, in every addressing mode;
+    anything else stops it. Each instruction counts as one
+    MCLK cycle.
+*/
+static uint16_t Fetch() {
+    uint16_t word = BusRead(sim->pc);
+    sim->pc = (sim->pc + 2) & AddrMask();
+    return word;
+}
+
+static uint16_t GetReg(int reg) {
+    return reg == 0 ? (uint16_t) sim->pc : sim->r[reg];
+}
+
+static void SetReg(int reg, uint16_t value) {
+    if (reg == 0) {
+        sim->pc = value;
+    } else if (reg != 3) {
+        sim->r[reg] = value;
+    }
+}
+
+static uint16_t Source(int reg, int as) {
+    if (reg == 3) {
+        static const uint16_t constants[4] = {0, 1, 2, 0xFFFF};
+        return constants[as];
+    }
+    if (reg == 2 && as >= 2) return as == 2 ? 4 : 8;
+    switch (as) {
+    case 0:
+        return GetReg(reg);
+    case 1: {
+        uint16_t base = reg == 2 ? 0 : GetReg(reg); // &abs, X(Rn) or symbolic
+        return BusRead((uint16_t) (base + Fetch()));
+    }
+    case 2:
+        return BusRead(GetReg(reg));
+    default:
+        if (reg == 0) return Fetch(); // #imm
+        uint16_t value = BusRead(GetReg(reg));
+        SetReg(reg, GetReg(reg) + 2);
+        return value;
+    }
+}
+
+static void SetFlags(uint32_t result, bool carry, bool overflow) {
+    uint16_t sr = sim->r[2] & ~(SR_C | SR_Z | SR_N | SR_V);
+    if ((result & 0xFFFF) == 0) sr |= SR_Z;
+    if (result & 0x8000) sr |= SR_N;
+    if (carry) sr |= SR_C;
+    if (overflow) sr |= SR_V;
+    sim->r[2] = sr;
+}
+
+static bool Condition(int cond) {
+    uint16_t sr = sim->r[2];
+    bool n = sr & SR_N, v = sr & SR_V;
+    switch (cond) {
+    case 0: return !(sr & SR_Z); // JNE
+    case 1: return sr & SR_Z;    // JEQ
+    case 2: return !(sr & SR_C); // JNC
+    case 3: return sr & SR_C;    // JC
+    case 4: return n;            // JN
+    case 5: return n == v;       // JGE
+    case 6: return n != v;       // JL
+    default: return true;        // JMP
+    }
+}
+
+static void CpuStep() {
+    FlashTick();
+    uint16_t op = Fetch();
+    if ((op & 0xE000) == 0x2000) {
+        int offset = op & 0x03FF;
+        if (offset & 0x0200) offset -= 0x0400;
+        if (Condition((op >> 10) & 0x07)) sim->pc = (sim->pc + 2 * offset) & AddrMask();
+        return;
+    }
+    int opcode = op >> 12;
+    if (opcode < 0x4 || (op & 0x0040)) {
+        sim->running = false; // format II and byte operations are not modelled
+        return;
+    }
+    int as = (op >> 4) & 0x03;
+    int dst = op & 0x0F;
+    uint16_t src = Source((op >> 8) & 0x0F, as);
+    uint16_t dst_addr = 0;
+    uint16_t value;
+    if (op & 0x0080) {
+        dst_addr = (dst == 2 ? 0 : GetReg(dst)) + Fetch();
+        value = opcode == 0x4 ? 0 : BusRead(dst_addr);
+    } else {
+        value = GetReg(dst);
+    }
+
+    uint32_t result;
+    bool store = true;
+    switch (opcode) {
+    case 0x4: // MOV
+        result = src;
+        break;
+    case 0x5: // ADD
+        result = (uint32_t) value + src;
+        SetFlags(result, result > 0xFFFF, (~(value ^ src) & (value ^ result)) & 0x8000);
+        break;
+    case 0x8: // SUB
+    case 0x9: // CMP
+        result = (uint32_t) value + (uint16_t) ~src + 1;
+        SetFlags(result, result > 0xFFFF, ((value ^ src) & (value ^ result)) & 0x8000);
+        store = opcode == 0x8;
+        break;
+    case 0xB: // BIT
+    case 0xF: // AND
+        result = value & src;
+        SetFlags(result, result != 0, false);
+        store = opcode == 0xF;
+        break;
+    case 0xC: // BIC
+        result = value & ~src;
+        break;
+    case 0xD: // BIS
+        result = value | src;
+        break;
+    case 0xE: // XOR
+        result = value ^ src;
+        SetFlags(result, (result & 0xFFFF) != 0, (value & src) & 0x8000);
+        break;
+    default:
+        sim->running = false;
+        return;
+    }
+    if (!store) return;
+    if (op & 0x0080) {
+        BusWrite(dst_addr, result);
+    } else {
+        SetReg(dst, result);
+    }
+}
+
+/*
+    Rising edge of TCK: TMS and TDI are sampled, shift
+    registers capture or shift, and the TAP advances.
+*/
+static void TckRise(int tms, int tdi) {
+    switch (sim->state) {
+    case TAP_RESET:
+        sim->ir = IR_BYPASS;
+        break;
+    case TAP_CAPTURE_IR:
+        // the ID leaves MSB first while instructions enter LSB first
+        sim->ir_shift = 0;
+        for (int i = 0; i < 8; i++) {
+            sim->ir_shift |= ((SIM_JTAG_ID >> i) & 1) << (7 - i);
+        }
+        break;
+    case TAP_SHIFT_IR:
+        sim->ir_shift = (sim->ir_shift >> 1) | (tdi << 7);
+        break;
+    case TAP_CAPTURE_DR:
+        if (sim->ir == IR_DATA_PSA) {
+            // every pass through Capture-DR feeds one word to the PSA
+            PsaStep(MemRead(sim->pc));
+            sim->pc += 2;
+        }
+        sim->dr_len = DrLength();
+        sim->dr_shift = CaptureDr();
+        break;
+    case TAP_SHIFT_DR:
+        sim->dr_shift = ((sim->dr_shift << 1) | tdi) & ((1u << sim->dr_len) - 1);
+        break;
+    default:
+        break;
+    }
+    sim->state = tap_next[sim->state][tms ? 1 : 0];
+    if (sim->state == TAP_IDLE) SetTclk(tdi);
+
+    for (int i = 0; sim->running && i < SIM_CPU_STEPS_PER_TCK; i++) {
+        CpuStep();
+    }
+}
+
+/*
+    Falling edge of TCK: TDO presents the next bit and
+    the update states latch the shifted value.
+*/
+static void TckFall() {
+    switch (sim->state) {
+    case TAP_SHIFT_IR:
+        sim->tdo = sim->ir_shift & 1;
+        break;
+    case TAP_SHIFT_DR:
+        sim->tdo = (sim->dr_shift >> (sim->dr_len - 1)) & 1;
+        break;
+    case TAP_UPDATE_IR:
+        sim->ir = sim->ir_shift;
+        // the CPU prefetches a word as quick access starts
+        if (sim->ir == IR_DATA_QUICK) sim->pc += 2;
+        if (sim->ir == IR_DATA_PSA) sim->psa = sim->pc - 2;
+        if (sim->ir == IR_CNTRL_SIG_RELEASE) {
+            sim->cntrl = 0;
+            sim->running = true;
+        }
+        break;
+    case TAP_UPDATE_DR:
+        UpdateDr(sim->dr_shift);
+        break;
+    default:
+        break;
+    }
+}
+
+void SimReset(void) {
+    bool cpux = sim->cpux;
+    memset(sim, 0, sizeof(*sim));
+    sim->cpux = cpux;
+    for (int i = 0; i < SIM_MEM_WORDS; i++) {
+        sim->mem[i] = 0xFFFF;
+    }
+    sim->state = TAP_RESET;
+    sim->ir = IR_BYPASS;
+    sim->fctl[2] = FCTL3_LOCK;
+    sim->powered = true;
+}
+
+void SimSetLinkLimit(uint32_t hz) {
+    link_half_ns = hz ? 500000000 / hz : 0;
+}
+
+void SimSetCpuX(bool enable) {
+    sim->cpux = enable;
+    SimReset();
+}
+
+void SimSetHang(sim_hang_t hang) {
+    sim->hang = hang;
+}
+
+void SimSetFetchDelay(int tclks) {
+    sim->fetch_delay = tclks;
+    sim->fetch_wait = 0;
+}
+
+const sim_stats_t *SimStats(void) {
+    return &sim->stats;
+}
+
+uint64_t SimTimeNs(void) {
+    return time_ns;
+}
+
+void SimClearStats(void) {
+    memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+uint16_t SimPeek(uint32_t addr) {
+    if (!sim->powered) SimReset();
+    return MemRead(addr);
+}
+
+void SimPoke(uint32_t addr, uint16_t data) {
+    if (!sim->powered) SimReset();
+    MemWrite(addr, data);
+}
+
+void SimSetGang(int count, const int *tdo_pins) {
+    sim_target_t *current = sim;
+    for (int i = 0; i < count; i++) {
+        target_tdo[i] = tdo_pins[i];
+        sim = &targets[i];
+        // new targets start with the pin levels of the first one
+        if (i >= target_count) {
+            sim->cpux = targets[0].cpux;
+            SimReset();
+            memcpy(sim->pins, targets[0].pins, sizeof(sim->pins));
+            sim->out = targets[0].out;
+        }
+    }
+    target_count = count;
+    sim = current < &targets[count] ? current : &targets[0];
+}
+
+void SimSelect(int target) {
+    sim = &targets[target];
+}
+
+void PinInit(void) {
+    sim_target_t *current = sim;
+    for (int i = 0; i < target_count; i++) {
+        sim = &targets[i];
+        if (!sim->powered) SimReset();
+        memset(sim->pins, 0, sizeof(sim->pins));
+        sim->out = 0;
+        sim->released = 0;
+        sim->tdo = 0;
+    }
+    sim = current;
+}
+
+// TDO pins only exist for the targets set with SimSetGang
+void PinInitTdo(int pin) {
+}
+
+/*
+    Edge of TEST, which is SBWTCK in Spy-Bi-Wire mode. A
+    pulse after TEST was low for long enables the TEST
+    logic, and the level of RST at the next rising edge
+    selects Spy-Bi-Wire (high) or 4-wire JTAG (low), as in
+    the entry sequences of SLAU320. Each JTAG TCK cycle
+    then takes three SBWTCK slots: TMS and TDI are latched
+    from RST on the falling edges of the first two, the
+    TAP is clocked as the TDI slot ends, and the target
+    drives TDO onto RST while SBWTCK is low in the third.
+*/
+static void TestEdge(int level) {
+    if (!level) {
+        sim->ten_fall_ns = time_ns;
+        if (!sim->sbw) return;
+        if (sim->sbw_slot == 0) {
+            sim->sbw_tms = sim->pins[RST];
+            TckFall();
+        } else if (sim->sbw_slot == 1) {
+            sim->sbw_tdi = sim->pins[RST];
+            if (sim->state == TAP_IDLE) SetTclk(sim->sbw_tdi);
+        } else {
+            sim->sbw_tdo = true;
+        }
+        return;
+    }
+
+    if (!sim->sbw && sim->hang == SIM_HANG_UNTIL_ENTRY) sim->hang = SIM_HANG_NONE;
+    if (time_ns - sim->ten_fall_ns >= SIM_SBW_LOW_MAX_NS) {
+        sim->sbw_armed = true;
+        sim->sbw = false;
+        return;
+    }
+    if (sim->sbw_armed) {
+        sim->sbw_armed = false;
+        sim->sbw = sim->pins[RST];
+        sim->sbw_slot = 0;
+        return;
+    }
+    if (!sim->sbw) return;
+    if (sim->sbw_slot == 1) {
+        sim->stats.tck_cycles++;
+        TckRise(sim->sbw_tms, sim->sbw_tdi);
+    }
+    sim->sbw_tdo = false;
+    sim->sbw_slot = (sim->sbw_slot + 1) % 3;
+}
+
+static void DriveTarget(int pin, int level) {
+    if (sim->pins[pin] == level) return;
+    sim->stats.toggles++;
+    sim->pins[pin] = level;
+    sim->out ^= PIN_MASK(pin);
+
+    if (pin == TEN) {
+        TestEdge(level);
+    } else if (sim->sbw || !sim->pins[TEN]) {
+        return;
+    } else if (pin == TCK) {
+        bool settled = time_ns - sim->tck_edge_ns >= link_half_ns;
+        sim->tck_edge_ns = time_ns;
+        if (level) {
+            sim->stats.tck_cycles++;
+            TckRise(sim->pins[TMS], sim->pins[TDI]);
+        } else {
+            TckFall();
+        }
+        if (level && !settled) sim->tdo ^= 1; // TDO read before it settled
+    } else if (pin == TDI && sim->state == TAP_IDLE) {
+        SetTclk(level);
+    }
+}
+
+// the lines are shared, so every target sees the edge
+static void Drive(int pin, int level) {
+    sim_target_t *current = sim;
+    for (int i = 0; i < target_count; i++) {
+        sim = &targets[i];
+        DriveTarget(pin, level);
+    }
+    sim = current;
+}
+
+/*
+    Applies one register store to every pin in mask. TCK
+    is driven last so that data pins written in the same
+    store are settled at the clock edge.
+*/
+static void DriveMask(uint32_t mask, int level) {
+    sim->stats.pin_writes++;
+    time_ns += SIM_STORE_NS;
+    for (uint32_t pins = mask & ~PIN_MASK(TCK); pins; pins &= pins - 1) {
+        Drive(__builtin_ctz(pins), level);
+    }
+    if (mask & PIN_MASK(TCK)) Drive(TCK, level);
+}
+
+void PinSet(int pin, uint32_t level) {
+    sim->stats.pin_writes++;
+    time_ns += SIM_STORE_NS;
+    Drive(pin, level ? 1 : 0);
+}
+
+/*
+    Level on a released pin: TDO while the target drives
+    it in the Spy-Bi-Wire TDO slot, else the pull-up of
+    RST.
+*/
+static int Released(int pin) {
+    if (pin == SBWTDIO && sim->sbw_tdo) return sim->tdo;
+    return 1;
+}
+
+int PinGet(int pin) {
+    sim->stats.pin_reads++;
+    for (int i = 0; i < target_count; i++) {
+        if (pin == target_tdo[i]) return targets[i].tdo;
+    }
+    if (sim->released & PIN_MASK(pin)) return Released(pin);
+    return sim->pins[pin];
+}
+
+void PortSet(uint32_t mask) {
+    DriveMask(mask, 1);
+}
+
+void PortClr(uint32_t mask) {
+    DriveMask(mask, 0);
+}
+
+uint32_t PortIn(void) {
+    sim->stats.pin_reads++;
+    uint32_t in = PortOut();
+    for (int i = 0; i < target_count; i++) {
+        if (targets[i].tdo) in |= PIN_MASK(target_tdo[i]);
+    }
+    for (uint32_t pins = sim->released; pins; pins &= pins - 1) {
+        int pin = __builtin_ctz(pins);
+        in = (in & ~PIN_MASK(pin)) | ((uint32_t) Released(pin) << pin);
+    }
+    return in;
+}
+
+void PortRelease(uint32_t mask) {
+    sim->stats.pin_writes++;
+    time_ns += SIM_STORE_NS;
+    sim->released |= mask;
+}
+
+void PortDrive(uint32_t mask) {
+    sim->stats.pin_writes++;
+    time_ns += SIM_STORE_NS;
+    sim->released &= ~mask;
+}
+
+uint32_t PortOut(void) {
+    return sim->out;
+}
+
+void DelayNs(uint32_t ns) {
+    time_ns += ns;
+}
+
+/*
+    The SPI peripheral is modelled as mode 0 clocking on
+    the simulated pins. A whole transfer counts as one pin
+    write, since the CPU only starts it.
+*/
+bool SpiInit(int clock_hz) {
+    return SpiSetClock(clock_hz);
+}
+
+bool SpiSetClock(int clock_hz) {
+    spi_half_ns = 500000000 / clock_hz;
+    return true;
+}
+
+void SpiAttach(void) {
+}
+
+void SpiDetach(void) {
+}
+
+uint32_t SpiTransfer(uint32_t data, int bits) {
+    uint32_t ret = 0;
+    sim->stats.pin_writes++;
+    for (int i = bits - 1; i >= 0; i--) {
+        Drive(TCK, 0);
+        Drive(TDI, (data >> i) & 0x01);
+        time_ns += spi_half_ns;
+        Drive(TCK, 1);
+        ret |= (uint32_t) sim->tdo << i;
+        time_ns += spi_half_ns;
+    }
+    Drive(TCK, 0);
+    return ret;
+}
+
+/*
+    The waveform peripheral is modelled by replaying the
+    samples on the simulated pins and recording TDO at
+    every rising TCK edge. The CPU cost is one pin write
+    for the whole transfer.
+*/
+bool WavePortInit(int tck_hz) {
+    wave_half_ns = 500000000 / tck_hz;
+    return true;
+}
+
+void WavePlay(const uint8_t *samples, size_t count, uint8_t *tdo, size_t tdo_bytes) {
+    sim->stats.pin_writes++;
+    memset(tdo, 0, tdo_bytes);
+    Drive(TCK, 0);
+    Drive(TMS, 0);
+    Drive(TDI, 0);
+
+    size_t cycle = 0;
+    for (size_t i = 0; i < count; i++) {
+        time_ns += wave_half_ns;
+        Drive(TMS, (samples[i] & WAVE_TMS) != 0);
+        Drive(TDI, (samples[i] & WAVE_TDI) != 0);
+        int tck = (samples[i] & WAVE_TCK) != 0;
+        if (tck && !sim->pins[TCK]) {
+            Drive(TCK, 1);
+            if (cycle / 8 < tdo_bytes) tdo[cycle / 8] |= sim->tdo << (7 - (cycle % 8));
+            cycle++;
+        } else {
+            Drive(TCK, tck);
+        }
+    }
+}
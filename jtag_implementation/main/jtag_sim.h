@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Simulated MSP430 target behind the linux pin backend.
+    It models the TAP controller, the 8-bit instruction
+    register (capturing JTAG ID 0x89), bypass, the address,
+    data and control signal registers, a memory array
+    accessed through TCLK cycles, and a flash controller
+    from 0x1000 up that times erase and write in TCLKs.
+*/
+
+typedef struct {
+    uint64_t pin_writes;  // PinSet calls and port stores
+    uint64_t pin_reads;   // PinGet calls and port loads
+    uint64_t toggles;     // pin level changes
+    uint64_t tck_cycles;  // rising edges of TCK
+    uint64_t tclk_cycles; // rising edges of TCLK (TDI in Run/Idle)
+    uint64_t flash_violations; // flash accesses the controller rejected
+} sim_stats_t;
+
+/*
+    Returns the target to power-up state: TAP in
+    Test-Logic-Reset, IR in bypass and all memory erased
+    to 0xFFFF. Statistics are cleared as well.
+*/
+void SimReset(void);
+
+/*
+    Switches between an MSP430 with a 16-bit address bus
+    (the default) and an MSP430X with 20-bit address
+    registers and 1 MB of memory. Resets the target.
+*/
+void SimSetCpuX(bool enable);
+
+/*
+    Models the wiring to the target: a TCK phase shorter
+    than half a period at hz leaves TDO unsettled, so the
+    bit read after that rising edge comes out inverted.
+    Time moves by a fixed cost per pin store, by DelayNs,
+    and by the SPI and waveform clock periods. 0, the
+    default, removes the limit.
+*/
+void SimSetLinkLimit(uint32_t hz);
+
+// simulated time since start-up, see SimSetLinkLimit
+uint64_t SimTimeNs(void);
+
+/*
+    Puts count targets (up to 4) on the shared TMS, TCK
+    and TDI lines, target i answering on tdo_pins[i]. New
+    targets start reset; 1 with {TDO} is the default.
+*/
+void SimSetGang(int count, const int *tdo_pins);
+
+/*
+    Selects the target that SimPeek, SimPoke, SimStats,
+    SimReset and SimSetCpuX act on, 0 by default.
+*/
+void SimSelect(int target);
+
+typedef enum {
+    SIM_HANG_NONE,
+    SIM_HANG_UNTIL_POR,   // a POR through the control signal register ends it
+    SIM_HANG_UNTIL_ENTRY, // only a rising edge of TEST in 4-wire mode does
+    SIM_HANG_ALWAYS,
+} sim_hang_t;
+
+/*
+    Makes the selected target stop answering the sync, as
+    on a bad fixture, until the event hang names. A target
+    reset ends it too.
+*/
+void SimSetHang(sim_hang_t hang);
+
+/*
+    Makes the selected target leave the instruction-fetch
+    state only after tclks TCLK cycles, counted again each
+    time the sync sets TCE1. 0 fetches at once.
+*/
+void SimSetFetchDelay(int tclks);
+
+const sim_stats_t *SimStats(void);
+void SimClearStats(void);
+
+/*
+    Direct access to target memory, bypassing JTAG.
+    Addresses are byte addresses and must be even.
+*/
+uint16_t SimPeek(uint32_t addr);
+void SimPoke(uint32_t addr, uint16_t data);
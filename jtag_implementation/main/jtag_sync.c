@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "jtag.h"
+#include "jtag_engine.h"
+#include "jtag_sync.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static sync_stats_t stats;
+
+/*
+    Wall time, the clock the FreeRTOS ticks of the sync
+    timeout run on, so a connect that waited one out shows
+    it. Simulated time would leave the wait out on the host.
+*/
+#if CONFIG_IDF_TARGET_LINUX
+static uint32_t NowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+#else
+static uint32_t NowUs(void) {
+    return esp_timer_get_time();
+}
+#endif
+
+bool SyncPoll(uint16_t mask) {
+    TickType_t start = xTaskGetTickCount();
+    int delay_ms = 0;
+    for (int poll = 0;; poll++) {
+        stats.polls++;
+        if (DR_SHIFT((uint16_t) 0x0000) & mask) return true;
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(SYNC_TIMEOUT_MS)) return false;
+        if (poll < SYNC_POLL_BURST) continue;
+        if (delay_ms == 0) {
+            delay_ms = 1;
+        } else if (delay_ms < SYNC_POLL_MAX_MS) {
+            delay_ms *= 2;
+        }
+        // below one tick (10 ms at 100 Hz) the conversion rounds to 0
+        TickType_t ticks = pdMS_TO_TICKS(delay_ms);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+static void AddLatency(uint32_t us) {
+    // the failures do not count this connect yet
+    bool first = stats.connects - stats.failures == 1;
+    if (first || us < stats.min_us) stats.min_us = us;
+    if (us > stats.max_us) stats.max_us = us;
+    int bucket = us ? 31 - __builtin_clz(us) : 0;
+    if (bucket >= SYNC_BUCKETS) bucket = SYNC_BUCKETS - 1;
+    stats.buckets[bucket]++;
+}
+
+bool ConnectDevice(void) {
+    uint32_t start = NowUs();
+    stats.connects++;
+    for (int attempt = 0; attempt < SYNC_ATTEMPTS; attempt++) {
+        if (attempt == 1) {
+            printf("Connect: retrying after a POR\n");
+            stats.por_retries++;
+            ExecutePOR();
+        } else if (attempt > 1) {
+            printf("Connect: retrying after a JTAG entry\n");
+            stats.entry_retries++;
+            if (GetShiftEngine() == &sbw_engine) {
+                EnterSBW();
+            } else {
+                EnterJTAG();
+            }
+        }
+        ResetTAP();
+        if (IR_SHIFT(IR_CNTRL_SIG_16BIT) != JTAG_ID) {
+            stats.no_id++;
+            continue;
+        }
+        if (!GetDevice()) {
+            stats.sync_timeouts++;
+            continue;
+        }
+        if (!SetInstrFetch()) {
+            stats.fetch_failures++;
+            continue;
+        }
+        HaltCPU();
+        AddLatency(NowUs() - start);
+        return true;
+    }
+    stats.failures++;
+    return false;
+}
+
+const sync_stats_t *SyncStats(void) {
+    return &stats;
+}
+
+void SyncClearStats(void) {
+    stats = (sync_stats_t) {0};
+}
+
+void SyncPrintStats(void) {
+    printf("Connects %lu, failed %lu; no ID %lu, sync timeouts %lu, no fetch %lu; "
+           "POR retries %lu, entry retries %lu; %lu polls\n",
+           (unsigned long) stats.connects, (unsigned long) stats.failures,
+           (unsigned long) stats.no_id, (unsigned long) stats.sync_timeouts,
+           (unsigned long) stats.fetch_failures, (unsigned long) stats.por_retries,
+           (unsigned long) stats.entry_retries, (unsigned long) stats.polls);
+    if (stats.connects == stats.failures) return;
+    printf("Connect latency %lu-%lu us:", (unsigned long) stats.min_us, (unsigned long) stats.max_us);
+    for (int bucket = 0; bucket < SYNC_BUCKETS; bucket++) {
+        if (stats.buckets[bucket] == 0) continue;
+        printf(" %lu: %lu", 1UL << bucket, (unsigned long) stats.buckets[bucket]);
+    }
+    printf("\n");
+}
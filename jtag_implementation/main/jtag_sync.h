@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Bounded connect to the target CPU. GetDevice polls for
+    the sync bit for at most SYNC_TIMEOUT_MS: SYNC_POLL_BURST
+    scans back to back, then one scan per delay, which
+    doubles up to SYNC_POLL_MAX_MS and lets other tasks
+    run. ConnectDevice retries a failed connect through
+    ExecutePOR, then through a new JTAG entry sequence, so
+    a target that does not answer costs a bounded time
+    instead of hanging the task.
+
+    Connect latencies go into a histogram of power-of-two
+    buckets in us, and every way a connect fails has a
+    counter, so a bad fixture shows up in the numbers.
+*/
+
+#define SYNC_TIMEOUT_MS 50  // GetDevice gives up after this
+#define SYNC_POLL_BURST 16  // scans in a row before the first delay
+#define SYNC_POLL_MAX_MS 8  // poll period the backoff stops at
+#define SYNC_ATTEMPTS 3     // plain, after a POR, after a JTAG entry
+#define SYNC_BUCKETS 21     // up to 2^21 us, about 2 s
+
+typedef struct {
+    uint32_t connects;      // ConnectDevice calls
+    uint32_t failures;      // connects that gave up after every attempt
+    uint32_t no_id;         // attempts without the JTAG ID after the TAP reset
+    uint32_t sync_timeouts; // attempts GetDevice timed out in
+    uint32_t fetch_failures; // attempts SetInstrFetch failed in
+    uint32_t por_retries;   // attempts made after ExecutePOR
+    uint32_t entry_retries; // attempts made after a JTAG entry sequence
+    uint32_t polls;         // sync scans, across all attempts
+    uint32_t min_us;        // of the successful connects
+    uint32_t max_us;
+    uint32_t buckets[SYNC_BUCKETS];
+} sync_stats_t;
+
+/*
+    Scans IR_CNTRL_SIG_CAPTURE, which must be selected,
+    until one of the bits in mask is set, backing off as
+    above.
+
+    Returns: false after SYNC_TIMEOUT_MS.
+*/
+bool SyncPoll(uint16_t mask);
+
+/*
+    Checks the JTAG ID after a TAP reset, then syncs the
+    CPU, sets instruction fetch and halts it, retrying as
+    above.
+
+    Returns: false if every attempt failed.
+*/
+bool ConnectDevice(void);
+
+const sync_stats_t *SyncStats(void);
+void SyncClearStats(void);
+
+/*
+    Prints the counters, then min and max latency and the
+    counts of every bucket in use, e.g. "256: 12" for
+    connects that took 256 to 511 us.
+*/
+void SyncPrintStats(void);
@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include "jtag_tap.h"
+
+static const uint8_t tap_next[TAP_STATES][2] = {
+    [TAP_RESET]      = {TAP_IDLE, TAP_RESET},
+    [TAP_IDLE]       = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_DR]  = {TAP_CAPTURE_DR, TAP_SELECT_IR},
+    [TAP_CAPTURE_DR] = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_SHIFT_DR]   = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_EXIT1_DR]   = {TAP_PAUSE_DR, TAP_UPDATE_DR},
+    [TAP_PAUSE_DR]   = {TAP_PAUSE_DR, TAP_EXIT2_DR},
+    [TAP_EXIT2_DR]   = {TAP_SHIFT_DR, TAP_UPDATE_DR},
+    [TAP_UPDATE_DR]  = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_IR]  = {TAP_CAPTURE_IR, TAP_RESET},
+    [TAP_CAPTURE_IR] = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_SHIFT_IR]   = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_EXIT1_IR]   = {TAP_PAUSE_IR, TAP_UPDATE_IR},
+    [TAP_PAUSE_IR]   = {TAP_PAUSE_IR, TAP_EXIT2_IR},
+    [TAP_EXIT2_IR]   = {TAP_SHIFT_IR, TAP_UPDATE_IR},
+    [TAP_UPDATE_IR]  = {TAP_IDLE, TAP_SELECT_DR},
+};
+
+// shortest paths between every pair of states, filled on first use
+static uint8_t path_tms[TAP_STATES][TAP_STATES];
+static uint8_t path_len[TAP_STATES][TAP_STATES];
+static bool paths_ready = false;
+
+tap_state_t TapNext(tap_state_t state, int tms) {
+    return tap_next[state][tms ? 1 : 0];
+}
+
+/*
+    Breadth-first search from every state. No path is
+    longer than 7 cycles, so the TMS bits fit a byte.
+*/
+static void BuildPaths(void) {
+    for (int from = 0; from < TAP_STATES; from++) {
+        uint8_t queue[TAP_STATES];
+        bool seen[TAP_STATES] = {false};
+        int head = 0;
+        int tail = 0;
+        queue[tail++] = from;
+        seen[from] = true;
+        path_tms[from][from] = 0;
+        path_len[from][from] = 0;
+        while (head < tail) {
+            int state = queue[head++];
+            // Test-Logic-Reset resets the target's IR, so only end there
+            if (state == TAP_RESET && state != from) continue;
+            for (int tms = 0; tms < 2; tms++) {
+                int next = tap_next[state][tms];
+                if (seen[next]) continue;
+                seen[next] = true;
+                path_len[from][next] = path_len[from][state] + 1;
+                path_tms[from][next] = path_tms[from][state] | (tms << path_len[from][state]);
+                queue[tail++] = next;
+            }
+        }
+    }
+    paths_ready = true;
+}
+
+int TapPath(tap_state_t from, tap_state_t to, uint32_t *tms) {
+    if (!paths_ready) BuildPaths();
+    *tms = path_tms[from][to];
+    return path_len[from][to];
+}
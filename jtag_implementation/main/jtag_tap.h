@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Model of the IEEE 1149.1 TAP controller, used by the
+    queue to track where the target's TAP is and to move
+    it with the fewest TCK cycles.
+*/
+
+typedef enum {
+    TAP_RESET,
+    TAP_IDLE,
+    TAP_SELECT_DR,
+    TAP_CAPTURE_DR,
+    TAP_SHIFT_DR,
+    TAP_EXIT1_DR,
+    TAP_PAUSE_DR,
+    TAP_EXIT2_DR,
+    TAP_UPDATE_DR,
+    TAP_SELECT_IR,
+    TAP_CAPTURE_IR,
+    TAP_SHIFT_IR,
+    TAP_EXIT1_IR,
+    TAP_PAUSE_IR,
+    TAP_EXIT2_IR,
+    TAP_UPDATE_IR,
+    TAP_STATES,
+} tap_state_t;
+
+// state after one TCK rising edge with the given TMS level
+tap_state_t TapNext(tap_state_t state, int tms);
+
+/*
+    Finds the shortest TMS sequence from one state to
+    another. Paths never pass through Test-Logic-Reset
+    unless it is the destination.
+
+    Returns: the number of TCK cycles, with their TMS
+    levels in *tms, LSB first. 0 if from is to.
+*/
+int TapPath(tap_state_t from, tap_state_t to, uint32_t *tms);
@@ -0,0 +1,122 @@
+#include "sdkconfig.h"
+#include "jtag_io.h"
+#include "jtag_trace.h"
+
+#if JTAG_TRACE
+
+#if CONFIG_IDF_TARGET_LINUX
+#include "jtag_sim.h"
+#else
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#endif
+
+static const char *const primitive_names[TRACE_PRIMITIVES] = {
+    "IR_SHIFT", "DR_SHIFT", "QueueFlush", "GetDevice",
+    "SetInstrFetch", "HaltCPU", "ReadMem", "WriteMem",
+};
+
+// timestamps and pin states are kept apart to save the padding
+static uint32_t times[TRACE_ENTRIES];
+static uint8_t states[TRACE_ENTRIES];
+static uint32_t total = 0; // states recorded, the ring holds the last TRACE_ENTRIES
+static uint8_t last_state = 0xFF;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_ns;
+    uint32_t max_ns;
+    uint32_t buckets[TRACE_BUCKETS];
+} histogram_t;
+
+static histogram_t histograms[TRACE_PRIMITIVES];
+
+#if CONFIG_IDF_TARGET_LINUX
+uint32_t TraceNow(void) {
+    return SimTimeNs();
+}
+
+static uint32_t TicksToNs(uint32_t ticks) {
+    return ticks;
+}
+#else
+uint32_t TraceNow(void) {
+    return esp_cpu_get_cycle_count();
+}
+
+static uint32_t TicksToNs(uint32_t ticks) {
+    return (uint64_t) ticks * 1000 / esp_rom_get_cpu_ticks_per_us();
+}
+#endif
+
+void TracePins(void) {
+    uint32_t out = PortOut();
+    uint8_t state = ((out >> TMS) & 0x01) | (((out >> TCK) & 0x01) << 1) |
+                    (((out >> TDI) & 0x01) << 2) | (((PortIn() >> TDO) & 0x01) << 3);
+    if (state == last_state) return;
+    last_state = state;
+    times[total % TRACE_ENTRIES] = TraceNow();
+    states[total % TRACE_ENTRIES] = state;
+    total++;
+}
+
+void TraceLatency(trace_primitive_t primitive, uint32_t start) {
+    uint32_t ns = TicksToNs(TraceNow() - start);
+    histogram_t *h = &histograms[primitive];
+    if (h->count == 0 || ns < h->min_ns) h->min_ns = ns;
+    if (ns > h->max_ns) h->max_ns = ns;
+    h->count++;
+    int bucket = ns ? 31 - __builtin_clz(ns) : 0;
+    if (bucket >= TRACE_BUCKETS) bucket = TRACE_BUCKETS - 1;
+    h->buckets[bucket]++;
+}
+
+void TraceClear(void) {
+    total = 0;
+    last_state = 0xFF;
+    for (int i = 0; i < TRACE_PRIMITIVES; i++) {
+        histograms[i] = (histogram_t) {0};
+    }
+}
+
+void TraceExportVcd(FILE *out) {
+    static const char ids[] = {'!', '"', '#', '$'};
+    static const char *const names[] = {"TMS", "TCK", "TDI", "TDO"};
+    fprintf(out, "$timescale 1 ns $end\n$scope module jtag $end\n");
+    for (int pin = 0; pin < 4; pin++) {
+        fprintf(out, "$var wire 1 %c %s $end\n", ids[pin], names[pin]);
+    }
+    fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+
+    uint32_t first = total > TRACE_ENTRIES ? total - TRACE_ENTRIES : 0;
+    uint64_t ns = 0;
+    uint8_t previous = 0;
+    for (uint32_t i = first; i < total; i++) {
+        uint32_t slot = i % TRACE_ENTRIES;
+        if (i > first) ns += TicksToNs(times[slot] - times[(i - 1) % TRACE_ENTRIES]);
+        fprintf(out, "#%llu\n", (unsigned long long) ns);
+        for (int pin = 0; pin < 4; pin++) {
+            uint8_t bit = 1 << pin;
+            if (i == first || ((states[slot] ^ previous) & bit)) {
+                fprintf(out, "%d%c\n", (states[slot] & bit) ? 1 : 0, ids[pin]);
+            }
+        }
+        previous = states[slot];
+    }
+}
+
+void TracePrintHistograms(void) {
+    for (int i = 0; i < TRACE_PRIMITIVES; i++) {
+        const histogram_t *h = &histograms[i];
+        if (h->count == 0) continue;
+        printf("%-14s %8lu calls, %lu-%lu ns:", primitive_names[i], (unsigned long) h->count,
+               (unsigned long) h->min_ns, (unsigned long) h->max_ns);
+        for (int bucket = 0; bucket < TRACE_BUCKETS; bucket++) {
+            if (h->buckets[bucket] == 0) continue;
+            printf(" %lu: %lu", 1UL << bucket, (unsigned long) h->buckets[bucket]);
+        }
+        printf("\n");
+    }
+}
+
+#endif
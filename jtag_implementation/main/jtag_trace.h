@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+    Optional recorder for timing problems, in place of a
+    logic analyzer. Every change of TMS, TCK, TDI or TDO
+    made by the bit-banged engines goes into a ring of the
+    last TRACE_ENTRIES pin states with a timestamp, and
+    the main primitives add their latency to a histogram
+    of power-of-two buckets in ns. Bits clocked by the SPI
+    peripheral or a waveform are not seen, so trace with a
+    GPIO engine.
+
+    With JTAG_TRACE at 0 the hooks are empty inlines and
+    cost nothing.
+*/
+
+#ifndef JTAG_TRACE
+#define JTAG_TRACE 0
+#endif
+
+#define TRACE_ENTRIES 4096
+#define TRACE_BUCKETS 24 // up to 2^24 ns, about 17 ms
+
+// pin bits of a recorded state
+#define TRACE_TMS 0x01
+#define TRACE_TCK 0x02
+#define TRACE_TDI 0x04
+#define TRACE_TDO 0x08
+
+typedef enum {
+    TRACE_IR_SHIFT,
+    TRACE_DR_SHIFT,
+    TRACE_QUEUE_FLUSH,
+    TRACE_GET_DEVICE,
+    TRACE_SET_INSTR_FETCH,
+    TRACE_HALT_CPU,
+    TRACE_READ_MEM,
+    TRACE_WRITE_MEM,
+    TRACE_PRIMITIVES,
+} trace_primitive_t;
+
+#if JTAG_TRACE
+
+/*
+    Timestamps are CPU cycles on the ESP32 and simulated
+    ns in the linux build, 32 bits wide. A gap longer than
+    one wrap (about 17 s at 240 MHz) shows up too short.
+*/
+uint32_t TraceNow(void);
+
+// records the pin levels if they changed since the last call
+void TracePins(void);
+
+// adds the time since start, from TraceNow, to the histogram
+void TraceLatency(trace_primitive_t primitive, uint32_t start);
+
+void TraceClear(void);
+
+/*
+    Writes the ring, oldest state first, as a VCD file with
+    one wire per pin and a 1 ns timescale.
+*/
+void TraceExportVcd(FILE *out);
+
+/*
+    Prints count, min and max per primitive and the counts
+    of every bucket in use, e.g. "1024: 37" for calls that
+    took 1024 to 2047 ns.
+*/
+void TracePrintHistograms(void);
+
+#else
+
+static inline uint32_t TraceNow(void) {
+    return 0;
+}
+
+static inline void TracePins(void) {
+}
+
+static inline void TraceLatency(trace_primitive_t primitive, uint32_t start) {
+}
+
+#endif
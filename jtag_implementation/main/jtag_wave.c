@@ -0,0 +1,126 @@
+#include <string.h>
+#include "jtag_engine.h"
+#include "jtag_io.h"
+#include "jtag_queue.h"
+#include "jtag_wave.h"
+
+static void Emit(wave_seq_t *seq, uint8_t level) {
+    if (seq->length >= seq->capacity) {
+        seq->overflow = true;
+        return;
+    }
+    seq->samples[seq->length++] = level;
+    seq->level = level;
+}
+
+// one TCK cycle: data pins change while TCK is low
+static void Cycle(wave_seq_t *seq, int tms, int tdi) {
+    uint8_t level = (tms ? WAVE_TMS : 0) | (tdi ? WAVE_TDI : 0);
+    Emit(seq, level);
+    Emit(seq, level | WAVE_TCK);
+    seq->cycles++;
+}
+
+static void SetTdi(wave_seq_t *seq, int tdi) {
+    uint8_t level = (seq->level & ~WAVE_TDI) | (tdi ? WAVE_TDI : 0);
+    if (level != seq->level) Emit(seq, level);
+}
+
+static wave_seq_t *recording = NULL;
+static const jtag_engine_t *replaced = NULL; // shift engine recording took over from
+
+static void RecordTms(uint32_t tms, int count) {
+    int tdi = recording->level & WAVE_TDI;
+    for (int i = 0; i < count; i++) {
+        Cycle(recording, (tms >> i) & 0x01, tdi);
+    }
+}
+
+static uint32_t RecordShift(uint32_t data, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        Cycle(recording, i == 0, (data >> i) & 0x01);
+    }
+    return 0; // filled in by WaveDecode
+}
+
+static void RecordSetTdi(uint32_t level) {
+    SetTdi(recording, level);
+}
+
+static int RecordGetTdi(void) {
+    return (recording->level & WAVE_TDI) != 0;
+}
+
+static void RecordCapture(void *dest, int size, int bits, int order) {
+    wave_seq_t *seq = recording;
+    if (seq->capture_count == seq->capture_capacity) {
+        seq->overflow = true;
+        return;
+    }
+    wave_capture_t *capture = &seq->captures[seq->capture_count++];
+    capture->cycle = seq->cycles; // the shift clocks its first bit next
+    capture->bits = bits;
+    capture->order = order;
+    capture->size = size;
+    capture->dest = dest;
+}
+
+static const jtag_engine_t record_engine = {
+    .name = "wave",
+    .tms = RecordTms,
+    .shift = RecordShift,
+    .set_tdi = RecordSetTdi,
+    .get_tdi = RecordGetTdi,
+    .capture = RecordCapture,
+};
+
+void WaveBegin(wave_seq_t *seq, uint8_t *samples, size_t capacity,
+               wave_capture_t *captures, int max_captures) {
+    // whatever was queued before belongs on the pins
+    QueueFlush();
+    memset(seq, 0, sizeof(*seq));
+    seq->samples = samples;
+    seq->capacity = capacity;
+    seq->captures = captures;
+    seq->capture_capacity = max_captures;
+    recording = seq;
+    replaced = GetShiftEngine();
+    SetShiftEngine(&record_engine);
+}
+
+void WaveEnd(wave_seq_t *seq) {
+    QueueFlush();
+    SetShiftEngine(replaced);
+    recording = NULL;
+}
+
+size_t WaveTdoBytes(const wave_seq_t *seq) {
+    return ((seq->cycles + 31) / 32) * 4;
+}
+
+void WaveDecode(const wave_seq_t *seq, const uint8_t *tdo) {
+    for (int c = 0; c < seq->capture_count; c++) {
+        const wave_capture_t *capture = &seq->captures[c];
+        uint32_t value = 0;
+        for (int i = 0; i < capture->bits; i++) {
+            uint32_t cycle = capture->cycle + i;
+            value = (value << 1) | ((tdo[cycle >> 3] >> (7 - (cycle & 0x07))) & 0x01);
+        }
+        if (capture->order == LSB_FIRST) value = ReverseBits(value, capture->bits);
+
+        if (capture->size == 1) {
+            *(uint8_t *) capture->dest = value;
+        } else if (capture->size == 2) {
+            *(uint16_t *) capture->dest = value;
+        } else {
+            *(uint32_t *) capture->dest = value;
+        }
+    }
+}
+
+bool WaveRun(const wave_seq_t *seq, uint8_t *tdo) {
+    if (seq->overflow) return false;
+    WavePlay(seq->samples, seq->length, tdo, WaveTdoBytes(seq));
+    WaveDecode(seq, tdo);
+    return true;
+}
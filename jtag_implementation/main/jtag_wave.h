@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "jtag.h"
+
+/*
+    Waveform engine. A whole sequence of scans, TMS paths
+    and TCLK edges is compiled into a buffer of pin
+    samples, which a peripheral clocks out by DMA at a
+    fixed rate. TDO is sampled once per TCK cycle into a
+    receive buffer and the wanted scan results are picked
+    out of it afterwards.
+
+    Sequences are not written by hand: while one is being
+    recorded, QueueFlush compiles the queued commands into
+    it instead of shifting them, so a waveform takes the
+    same scans and TAP paths as the routines of jtag.c it
+    is recorded from.
+
+    Every sample holds the levels of TMS, TCK and TDI.
+    A TCK cycle takes two samples (TCK low, then high),
+    a TCLK edge takes one. The TAP starts and ends each
+    flush in Run/Idle, just like on the pins.
+*/
+
+#define WAVE_TMS 0x01
+#define WAVE_TCK 0x02
+#define WAVE_TDI 0x04
+
+// longest sequence the ESP32 player takes in one transfer
+#define WAVE_MAX_SAMPLES 8192
+
+typedef struct {
+    uint32_t cycle; // TCK cycle of the first data bit
+    uint8_t bits;
+    uint8_t order;  // bit_order_t
+    uint8_t size;   // sizeof *dest: 1, 2 or 4
+    void *dest;
+} wave_capture_t;
+
+typedef struct {
+    uint8_t *samples;
+    size_t length;
+    size_t capacity;
+    uint32_t cycles;        // TCK cycles compiled so far
+    uint8_t level;          // pin levels after the last sample
+    wave_capture_t *captures;
+    int capture_count;
+    int capture_capacity;
+    bool overflow;          // a buffer ran out, sequence is unusable
+} wave_seq_t;
+
+/*
+    Starts an empty sequence in caller-supplied buffers
+    and records into it until WaveEnd. Results of the
+    recorded scans only arrive with WaveRun, so routines
+    that act on one, such as GetDevice, cannot be
+    recorded. The sequence starts with all pins low,
+    since that is where WavePlay leaves them at the
+    handover, so TCLK is low from the first sample.
+*/
+void WaveBegin(wave_seq_t *seq, uint8_t *samples, size_t capacity,
+               wave_capture_t *captures, int max_captures);
+
+/*
+    Compiles what is still queued and stops recording,
+    putting the shift engine back.
+*/
+void WaveEnd(wave_seq_t *seq);
+
+/*
+    Bytes of TDO receive buffer needed for the sequence,
+    one bit per TCK cycle, rounded up to whole words.
+*/
+size_t WaveTdoBytes(const wave_seq_t *seq);
+
+/*
+    Fills in every capture from a TDO buffer holding one
+    bit per TCK cycle, MSB first within each byte.
+*/
+void WaveDecode(const wave_seq_t *seq, const uint8_t *tdo);
+
+/*
+    Plays a sequence recorded to its end on the pins and
+    decodes the captures. tdo must hold WaveTdoBytes and
+    be DMA capable. Returns false if the sequence
+    overflowed.
+*/
+bool WaveRun(const wave_seq_t *seq, uint8_t *tdo);
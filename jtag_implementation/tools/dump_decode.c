@@ -0,0 +1,149 @@
+/*
+    Rebuilds a raw memory image from a binary dump captured
+    off the serial port (see main/jtag_dump.h). Text the
+    console printed between frames is skipped, and frames
+    with a bad CRC are reported and left out. Gaps in the
+    image are filled with 0xFF.
+
+    Build:  cc -O2 -I../main -o dump_decode dump_decode.c
+    Use:    stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > dump.log
+            ./dump_decode dump.log image.bin
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jtag_dump.h"
+
+#define IMAGE_BYTES 0x100000 // 20-bit address space
+
+static uint8_t image[IMAGE_BYTES];
+
+static uint16_t Crc16(const uint8_t *data, int length, uint16_t crc) {
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t Get16(const uint8_t *in) {
+    return in[0] | (in[1] << 8);
+}
+
+static void Store(uint32_t addr, uint16_t word) {
+    if (addr + 1 >= IMAGE_BYTES) return;
+    image[addr] = word;
+    image[addr + 1] = word >> 8;
+}
+
+/*
+    Expands a payload into the image.
+
+    Returns: false if it does not hold exactly words words.
+*/
+static bool Decode(uint32_t addr, int words, const uint8_t *payload, int size) {
+    int pos = 0;
+    int done = 0;
+    while (pos < size) {
+        uint8_t token = payload[pos++];
+        if (token == DUMP_RUN) {
+            if (pos + 4 > size) return false;
+            int count = Get16(&payload[pos]);
+            uint16_t word = Get16(&payload[pos + 2]);
+            pos += 4;
+            for (int i = 0; i < count; i++) {
+                Store(addr + 2 * (done + i), word);
+            }
+            done += count;
+        } else if (token < DUMP_RUN) {
+            int count = token + 1;
+            if (pos + 2 * count > size) return false;
+            for (int i = 0; i < count; i++) {
+                Store(addr + 2 * (done + i), Get16(&payload[pos + 2 * i]));
+            }
+            pos += 2 * count;
+            done += count;
+        } else {
+            return false;
+        }
+    }
+    return done == words;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s dump.log image.bin\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *log = malloc(length);
+    if (log == NULL || fread(log, 1, length, in) != (size_t) length) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    memset(image, 0xFF, sizeof(image));
+    uint32_t low = IMAGE_BYTES, high = 0;
+    int frames = 0, bad = 0;
+    bool ended = false;
+    long pos = 0;
+    while (!ended && pos + 12 <= length) {
+        if (log[pos] != DUMP_MAGIC0 || log[pos + 1] != DUMP_MAGIC1) {
+            pos++;
+            continue;
+        }
+        const uint8_t *frame = &log[pos];
+        uint32_t addr = Get16(&frame[2]) | ((uint32_t) Get16(&frame[4]) << 16);
+        int words = Get16(&frame[6]);
+        int size = Get16(&frame[8]);
+        if (words > DUMP_BLOCK_WORDS || size > DUMP_MAX_PAYLOAD || pos + 12 + size > length) {
+            pos++; // not a frame after all
+            continue;
+        }
+        if (Crc16(&frame[2], 8 + size, 0xFFFF) != Get16(&frame[10 + size])) {
+            fprintf(stderr, "bad CRC at 0x%05x\n", (unsigned) addr);
+            bad++;
+            pos++;
+            continue;
+        }
+        if (!Decode(addr, words, &frame[10], size)) {
+            fprintf(stderr, "bad payload at 0x%05x\n", (unsigned) addr);
+            bad++;
+        } else if (words == 0) {
+            ended = true;
+        } else {
+            if (addr < low) low = addr;
+            if (addr + 2 * words > high) high = addr + 2 * words;
+            frames++;
+        }
+        pos += 12 + size;
+    }
+    free(log);
+
+    if (frames == 0) {
+        fprintf(stderr, "no frames found\n");
+        return 1;
+    }
+    if (high > IMAGE_BYTES) high = IMAGE_BYTES;
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL || fwrite(&image[low], 1, high - low, out) != high - low) {
+        perror(argv[2]);
+        return 1;
+    }
+    fclose(out);
+    printf("0x%05x-0x%05x: %d frames, %d bad%s\n", (unsigned) low, (unsigned) high - 1, frames,
+           bad, ended ? "" : ", end of dump missing");
+    return bad == 0 && ended ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/*
+    Scripted GDB remote serial protocol session against the
+    server of main/jtag_gdb.c (GDB_SERVER). It loads a
+    small program into RAM, steps it and checks the
+    registers, checks the m/M address limits, then
+    continues, interrupts and detaches. The target must
+    have RAM at 0x0200. Any unexpected reply stops the run
+    with exit status 1.
+
+    Build:  cc -O2 -o gdb_check gdb_check.c
+    Use:    ./gdb_check /dev/pts/3   (the linux build prints "Link: ...")
+            ./gdb_check /dev/ttyUSB1 (GDB_UART_NUM on the ESP32)
+*/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define REPLY_TIMEOUT_MS 5000
+#define PACKET_MAX 2048
+
+static int port;
+static char reply[PACKET_MAX];
+
+static void Fail(const char *message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+static void OpenPort(const char *path) {
+    port = open(path, O_RDWR | O_NOCTTY);
+    if (port < 0) {
+        perror(path);
+        exit(1);
+    }
+    struct termios tio;
+    if (tcgetattr(port, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(port, TCSANOW, &tio);
+    }
+    tcflush(port, TCIFLUSH);
+}
+
+static int GetByte(void) {
+    struct pollfd fd = {.fd = port, .events = POLLIN};
+    if (poll(&fd, 1, REPLY_TIMEOUT_MS) <= 0) Fail("no reply from the server");
+    uint8_t c;
+    if (read(port, &c, 1) != 1) Fail("port closed");
+    return c;
+}
+
+static void Write(const void *data, int length) {
+    if (write(port, data, length) != length) Fail("write failed");
+}
+
+static int HexValue(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// reads $data#xx into reply, checks the checksum and acknowledges
+static void GetPacket(void) {
+    while (GetByte() != '$') {
+    }
+    int length = 0;
+    uint8_t sum = 0;
+    int c;
+    while ((c = GetByte()) != '#') {
+        if (length == PACKET_MAX - 1) Fail("packet too long");
+        reply[length++] = c;
+        sum += c;
+    }
+    reply[length] = '\0';
+    int high = HexValue(GetByte());
+    int low = HexValue(GetByte());
+    if (high < 0 || low < 0 || ((high << 4) | low) != sum) Fail("bad checksum");
+    Write("+", 1);
+}
+
+// sends a packet and waits for the ack and the reply
+static const char *Command(const char *data) {
+    char packet[PACKET_MAX + 4];
+    uint8_t sum = 0;
+    for (const char *p = data; *p; p++) {
+        sum += *p;
+    }
+    int length = snprintf(packet, sizeof(packet), "$%s#%02x", data, sum);
+    Write(packet, length);
+    if (GetByte() != '+') Fail("packet not acknowledged");
+    GetPacket();
+    return reply;
+}
+
+static void Expect(const char *data, const char *expected) {
+    const char *got = Command(data);
+    printf("%-24s %s\n", data, got);
+    if (strcmp(got, expected) != 0) {
+        fprintf(stderr, "expected %s\n", expected);
+        exit(1);
+    }
+}
+
+static uint16_t RegisterAt(const char *regs, int reg) {
+    const char *p = &regs[4 * reg];
+    if ((int) strlen(regs) < 4 * (reg + 1)) Fail("register reply too short");
+    // little endian bytes
+    return (HexValue(p[0]) << 4 | HexValue(p[1])) | (HexValue(p[2]) << 4 | HexValue(p[3])) << 8;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s port\n", argv[0]);
+        return 1;
+    }
+    OpenPort(argv[1]);
+
+    const char *supported = Command("qSupported:multiprocess+");
+    printf("%-24s %s\n", "qSupported", supported);
+    if (strncmp(supported, "PacketSize=", 11) != 0) Fail("no PacketSize");
+    Expect("?", "S05");
+
+    Expect("M200,8:3440", "E01"); // data shorter than the length
+    // MOV #0x1234, R4; ADD R4, R5; JMP $
+    Expect("M200,8:344034120554ff3f", "OK");
+    Expect("m200,8", "344034120554ff3f");
+    Expect("P0=0002", "OK");
+    Expect("P5=0100", "OK");
+    Expect("s", "S05");
+    Expect("s", "S05");
+    const char *regs = Command("g");
+    printf("%-24s %s\n", "g", regs);
+    if (RegisterAt(regs, 0) != 0x0206 || RegisterAt(regs, 4) != 0x1234 || RegisterAt(regs, 5) != 0x1235) {
+        Fail("registers do not match the program");
+    }
+
+    // ranges past 64 KB, including ones whose end would wrap
+    Expect("mffff,2", "E02");
+    Expect("m10000,2", "E02");
+    Expect("mffffffff,2", "E02");
+    Expect("m100000200,2", "E02");
+    Expect("Mffffffff,2:0000", "E02");
+
+    // a byte on its own keeps the other half of its word
+    Expect("M201,1:aa", "OK");
+    Expect("m200,2", "34aa");
+
+    // continue, then interrupt
+    Write("$c#63", 5);
+    if (GetByte() != '+') Fail("continue not acknowledged");
+    usleep(300000);
+    Write("\x03", 1);
+    GetPacket();
+    printf("%-24s %s\n", "c, interrupt", reply);
+    if (reply[0] != 'S' && reply[0] != 'T') Fail("no stop reply");
+
+    Expect("D", "OK");
+    printf("GDB session ok\n");
+    return 0;
+}
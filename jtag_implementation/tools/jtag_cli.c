@@ -0,0 +1,402 @@
+/*
+    Drives the ESP32 over the binary command protocol (see
+    main/jtag_cmd.h, CMD_SERVER). Commands run in the
+    order given, and up to CMD_WINDOW frames are kept in
+    flight, so a program overlaps the serial transfer of
+    each block with the JTAG work on the one before. Any
+    failed command stops the run with exit status 1.
+
+    Build:  cc -O2 -I../main -o jtag_cli jtag_cli.c
+    Use:    ./jtag_cli [-b baud] /dev/ttyUSB0 connect program 0xC000 fw.bin release
+
+    Commands:
+        connect                  TAP reset, sync and halt
+        halt                     take a running CPU back
+        read addr bytes [file]   to file, or a hex dump
+        write addr file          flash must be erased
+        erase addr|main|mass     one segment, or as named
+        verify addr file
+        program addr file        erase, write and verify
+        release [addr]           reset and run, or run from addr
+*/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "jtag_cmd.h"
+#include "jtag_flash.h"
+
+#define REPLY_TIMEOUT_MS 5000 // a mass erase takes a few hundred
+
+typedef struct {
+    bool busy;
+    uint8_t op;
+    uint32_t addr;
+    uint8_t *data; // where the reply data goes
+    int data_bytes;
+} pending_t;
+
+static int port;
+static uint8_t rx[4096];
+static int rx_len;
+static int rx_pos;
+static pending_t pending[256]; // by seq
+static uint8_t next_seq;
+static int in_flight;
+
+static const char *op_names[] = {
+    "sync", "connect", "halt", "read", "write", "erase", "verify", "release",
+};
+
+static const char *status_names[] = {
+    "ok", "frame damaged", "bad command", "no target", "verify failed",
+};
+
+static uint16_t Crc16(const uint8_t *data, int length, uint16_t crc) {
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void Put16(uint8_t *out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+static void Put32(uint8_t *out, uint32_t value) {
+    Put16(out, value);
+    Put16(&out[2], value >> 16);
+}
+
+static void Fail(const char *message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+static speed_t BaudRate(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    }
+    Fail("unsupported baud rate");
+    return B0;
+}
+
+static void OpenPort(const char *path, long baud) {
+    port = open(path, O_RDWR | O_NOCTTY);
+    if (port < 0) {
+        perror(path);
+        exit(1);
+    }
+    struct termios tio;
+    if (tcgetattr(port, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, BaudRate(baud));
+        cfsetospeed(&tio, BaudRate(baud));
+        tcsetattr(port, TCSANOW, &tio);
+    }
+    tcflush(port, TCIFLUSH);
+    // unlikely to match the seq of replies still on their way
+    next_seq = getpid();
+}
+
+static int GetByte(void) {
+    if (rx_pos == rx_len) {
+        struct pollfd fd = {.fd = port, .events = POLLIN};
+        if (poll(&fd, 1, REPLY_TIMEOUT_MS) <= 0) Fail("no reply from the ESP32");
+        rx_len = read(port, rx, sizeof(rx));
+        if (rx_len <= 0) Fail("port closed");
+        rx_pos = 0;
+    }
+    return rx[rx_pos++];
+}
+
+/*
+    Waits for the next reply frame, skipping console text,
+    and leaves it in frame.
+
+    Returns: false if its CRC is wrong.
+*/
+static bool GetReply(uint8_t *frame) {
+    int c = 0;
+    while (true) {
+        while (c != CMD_MAGIC0) {
+            c = GetByte();
+        }
+        if ((c = GetByte()) == CMD_MAGIC1) break;
+    }
+    for (int i = 2; i < 6; i++) {
+        frame[i] = GetByte();
+    }
+    int length = frame[4] | (frame[5] << 8);
+    if (length < 1 || length > CMD_MAX_PAYLOAD) return false;
+    for (int i = 6; i < 6 + length + 2; i++) {
+        frame[i] = GetByte();
+    }
+    uint16_t crc = Crc16(&frame[2], 4 + length, 0xFFFF);
+    return (frame[6 + length] | (frame[7 + length] << 8)) == crc;
+}
+
+/*
+    Retires the oldest command in flight. Replies to none,
+    left over from a run that stopped early, are skipped.
+*/
+static void Complete(void) {
+    uint8_t frame[CMD_FRAME_MAX];
+    pending_t *p;
+    do {
+        if (!GetReply(frame)) Fail("reply damaged on the way");
+        p = &pending[frame[2]];
+    } while (!p->busy || frame[3] != (p->op | CMD_REPLY));
+    int length = (frame[4] | (frame[5] << 8)) - 1;
+    uint8_t status = frame[6];
+    if (status != CMD_OK) {
+        fprintf(stderr, "%s at 0x%05X: %s\n", op_names[p->op], (unsigned) p->addr,
+                status < sizeof(status_names) / sizeof(status_names[0]) ? status_names[status] : "?");
+        exit(1);
+    }
+    if (p->data != NULL) {
+        if (length != p->data_bytes) Fail("reply of the wrong length");
+        memcpy(p->data, &frame[7], length);
+    }
+    p->busy = false;
+    in_flight--;
+}
+
+// sends a command once the window has room for it
+static void Send(uint8_t op, uint32_t addr, const uint8_t *payload, int length,
+                 uint8_t *data, int data_bytes) {
+    while (in_flight == CMD_WINDOW) {
+        Complete();
+    }
+    uint8_t frame[CMD_FRAME_MAX];
+    frame[0] = CMD_MAGIC0;
+    frame[1] = CMD_MAGIC1;
+    frame[2] = next_seq;
+    frame[3] = op;
+    Put16(&frame[4], length);
+    if (length > 0) memcpy(&frame[6], payload, length);
+    Put16(&frame[6 + length], Crc16(&frame[2], 4 + length, 0xFFFF));
+    if (write(port, frame, 8 + length) != 8 + length) Fail("write to the port failed");
+    pending[next_seq] = (pending_t) {true, op, addr, data, data_bytes};
+    next_seq++;
+    in_flight++;
+}
+
+static void Drain(void) {
+    while (in_flight > 0) {
+        Complete();
+    }
+}
+
+// reads a whole file, padded with 0xFF to whole words
+static uint8_t *LoadFile(const char *path, int *length) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    uint8_t *data = malloc(size + 1);
+    if (data == NULL || fread(data, 1, size, in) != (size_t) size) Fail("could not read the file");
+    fclose(in);
+    if (size & 1) data[size++] = 0xFF;
+    *length = size;
+    return data;
+}
+
+static void Read(uint32_t addr, int length, uint8_t *data) {
+    for (int offset = 0; offset < length; offset += 2 * CMD_BLOCK_WORDS) {
+        int bytes = length - offset < 2 * CMD_BLOCK_WORDS ? length - offset : 2 * CMD_BLOCK_WORDS;
+        uint8_t payload[6];
+        Put32(payload, addr + offset);
+        Put16(&payload[4], bytes / 2);
+        Send(CMD_READ, addr + offset, payload, 6, &data[offset], bytes);
+    }
+    Drain();
+}
+
+static void Write(uint32_t addr, const uint8_t *data, int length) {
+    uint8_t payload[CMD_MAX_PAYLOAD];
+    for (int offset = 0; offset < length; offset += 2 * CMD_BLOCK_WORDS) {
+        int bytes = length - offset < 2 * CMD_BLOCK_WORDS ? length - offset : 2 * CMD_BLOCK_WORDS;
+        Put32(payload, addr + offset);
+        memcpy(&payload[4], &data[offset], bytes);
+        Send(CMD_WRITE, addr + offset, payload, 4 + bytes, NULL, 0);
+    }
+}
+
+static void Verify(uint32_t addr, const uint8_t *data, int length) {
+    uint8_t payload[CMD_MAX_PAYLOAD];
+    for (int offset = 0; offset < length; offset += 2 * CMD_BLOCK_WORDS) {
+        int bytes = length - offset < 2 * CMD_BLOCK_WORDS ? length - offset : 2 * CMD_BLOCK_WORDS;
+        Put32(payload, addr + offset);
+        Put16(&payload[4], bytes / 2);
+        memcpy(&payload[6], &data[offset], bytes);
+        Send(CMD_VERIFY, addr + offset, payload, 6 + bytes, NULL, 0);
+    }
+}
+
+static void Erase(uint16_t mode, uint32_t addr) {
+    uint8_t payload[6];
+    Put16(payload, mode);
+    Put32(&payload[2], addr);
+    Send(CMD_ERASE, addr, payload, 6, NULL, 0);
+}
+
+// erases every segment the image touches, then writes and verifies it
+static void Program(uint32_t addr, const uint8_t *data, int length) {
+    uint32_t segment = addr;
+    while (segment < addr + length) {
+        int size = segment < FLASH_MAIN_START ? FLASH_INFO_SEGMENT : FLASH_MAIN_SEGMENT;
+        segment &= ~(uint32_t) (size - 1);
+        Erase(ERASE_SGMT, segment);
+        segment += size;
+    }
+    Write(addr, data, length);
+    Verify(addr, data, length);
+    Drain();
+}
+
+static void HexDump(uint32_t addr, const uint8_t *data, int length) {
+    for (int i = 0; i < length; i += 16) {
+        printf("%05X:", (unsigned) (addr + i));
+        for (int j = i; j < i + 16 && j < length; j++) {
+            printf(" %02X", data[j]);
+        }
+        printf("\n");
+    }
+}
+
+static void Usage(void) {
+    fprintf(stderr,
+            "usage: jtag_cli [-b baud] port command...\n"
+            "  connect | halt | read addr bytes [file] | write addr file\n"
+            "  erase addr|main|mass | verify addr file | program addr file\n"
+            "  release [addr]\n");
+    exit(1);
+}
+
+static bool IsCommand(const char *arg) {
+    static const char *commands[] = {
+        "connect", "halt", "read", "write", "erase", "verify", "program", "release",
+    };
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(arg, commands[i]) == 0) return true;
+    }
+    return false;
+}
+
+static uint32_t Number(char **argv, int *i, int argc) {
+    if (*i >= argc) Usage();
+    char *end;
+    uint32_t value = strtoul(argv[*i], &end, 0);
+    if (*end != '\0') Usage();
+    (*i)++;
+    return value;
+}
+
+static const char *Name(char **argv, int *i, int argc) {
+    if (*i >= argc) Usage();
+    return argv[(*i)++];
+}
+
+int main(int argc, char **argv) {
+    long baud = 115200;
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+        baud = strtol(argv[i + 1], NULL, 0);
+        i += 2;
+    }
+    if (i + 1 >= argc) Usage();
+    OpenPort(argv[i++], baud);
+
+    // replies left over from an earlier run come out first
+    Send(CMD_SYNC, 0, NULL, 0, NULL, 0);
+    Drain();
+
+    while (i < argc) {
+        const char *command = argv[i++];
+        if (strcmp(command, "connect") == 0) {
+            uint8_t id;
+            Send(CMD_CONNECT, 0, NULL, 0, &id, 1);
+            Drain();
+            printf("JTAG ID: 0x%02X\n", id);
+        } else if (strcmp(command, "halt") == 0) {
+            Send(CMD_HALT, 0, NULL, 0, NULL, 0);
+            Drain();
+        } else if (strcmp(command, "read") == 0) {
+            uint32_t addr = Number(argv, &i, argc);
+            int length = (Number(argv, &i, argc) + 1) & ~1;
+            uint8_t *data = malloc(length);
+            Read(addr, length, data);
+            if (i < argc && !IsCommand(argv[i])) {
+                FILE *out = fopen(argv[i++], "wb");
+                if (out == NULL || fwrite(data, 1, length, out) != (size_t) length) {
+                    Fail("could not write the file");
+                }
+                fclose(out);
+            } else {
+                HexDump(addr, data, length);
+            }
+            free(data);
+        } else if (strcmp(command, "write") == 0 || strcmp(command, "verify") == 0 ||
+                   strcmp(command, "program") == 0) {
+            uint32_t addr = Number(argv, &i, argc);
+            int length;
+            uint8_t *data = LoadFile(Name(argv, &i, argc), &length);
+            if (command[0] == 'w') {
+                Write(addr, data, length);
+                Drain();
+            } else if (command[0] == 'v') {
+                Verify(addr, data, length);
+                Drain();
+            } else {
+                Program(addr, data, length);
+                printf("Programmed %d bytes at 0x%05X\n", length, (unsigned) addr);
+            }
+            free(data);
+        } else if (strcmp(command, "erase") == 0) {
+            const char *what = Name(argv, &i, argc);
+            if (strcmp(what, "main") == 0) {
+                Erase(ERASE_MAIN, FLASH_MAIN_START);
+            } else if (strcmp(what, "mass") == 0) {
+                Erase(ERASE_MASS, FLASH_MAIN_START);
+            } else {
+                i--;
+                Erase(ERASE_SGMT, Number(argv, &i, argc));
+            }
+            Drain();
+        } else if (strcmp(command, "release") == 0) {
+            uint8_t payload[4];
+            if (i < argc && argv[i][0] >= '0' && argv[i][0] <= '9') {
+                Put32(payload, Number(argv, &i, argc));
+                Send(CMD_RELEASE, 0, payload, 4, NULL, 0);
+            } else {
+                Send(CMD_RELEASE, 0, NULL, 0, NULL, 0);
+            }
+            Drain();
+        } else {
+            Usage();
+        }
+    }
+    close(port);
+    return 0;
+}